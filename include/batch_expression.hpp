@@ -0,0 +1,93 @@
+#pragma once
+#ifndef BATCH_EXPRESSION_HPP
+#define BATCH_EXPRESSION_HPP
+
+#include <expression.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+	\brief BatchExpression class runs a compiled Expression over columns of values.
+
+	Variables are bound to columns of int64_t or double. The code is turned into a list
+	of steps with the types of every intermediate known up front, and each step runs one
+	plain loop kernel over a block of rows, so per-row work is free of dispatch and can be
+	vectorized by the compiler. Booleans are columns of uint8_t holding 0 or 1.
+
+	The results match Evaluator except where Evaluator would change the type of a value
+	for some rows: integer overflow and negative integer exponents are errors here.
+	Both operands of && and || are evaluated for every row, so an error in the right
+	operand is reported even for rows where Evaluator would skip it.
+**/
+class BatchExpression
+{
+public:
+	enum class Type : uint8_t
+	{
+		integer,	// int64_t
+		floating,	// double
+		boolean,	// uint8_t
+	};
+
+	static constexpr size_t block_rows = 1024;
+
+	/**
+		\brief Prepares expression for columns of the given names and types.
+
+		Columns the expression doesn't use are allowed. Returns false and sets error
+		if the expression uses an unknown name, a string or nil, or an operator on
+		types it doesn't apply to.
+	**/
+	bool compile(
+		const Expression& expression,
+		const std::vector<std::pair<std::string, Type>>& columns,
+		std::string& error
+	);
+
+	Type result_type() const { return m_result_type; }
+
+	/**
+		\brief Evaluates rows [0, rows).
+
+		columns are in the order given to compile(), each holding rows values of its type.
+		out receives rows values of result_type(). Returns false and sets error on
+		overflow or a division by zero, out is partly written then.
+	**/
+	bool run(const std::vector<const void*>& columns, size_t rows, void* out, std::string& error);
+
+	using Kernel = bool (*)(const void* a, const void* b, void* out, size_t rows);
+
+private:
+	struct Register
+	{
+		Type		m_type;
+		int			m_column	= -1;	// bound column or -1
+		bool		m_constant	= false;
+		uint64_t	m_bits		= 0;	// of a constant, as a column holds it
+		void*		m_data		= nullptr;
+	};
+
+	struct Step
+	{
+		Kernel		m_kernel;
+		size_t		m_a, m_b, m_out;	// registers
+		const char*	m_error;
+	};
+
+	std::vector<Register>	m_registers;
+	std::vector<Step>		m_steps;
+	size_t					m_result	= 0;
+	Type					m_result_type = Type::integer;
+
+	std::vector<uint64_t>	m_buffers;	// block_rows values for every register
+
+	size_t add_register(Type type);
+	void add_step(Kernel kernel, size_t a, size_t b, size_t out, const char* error);
+	// converts an integer register to floating, other registers are returned as they are
+	size_t to_floating(size_t reg);
+};
+
+#endif // !BATCH_EXPRESSION_HPP
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+#include <protocol.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+	\brief Client class talks to a Server over its Unix domain socket.
+**/
+class Client
+{
+public:
+	Client() = default;
+	~Client();
+
+	Client(const Client&)				= delete;
+	Client& operator=(const Client&)	= delete;
+
+	// false with errno set if the connection fails
+	bool connect(const std::string& socket_path);
+	void close();
+
+	/**
+		\brief Sends requests and waits for their responses.
+
+		Responses are read while the requests are sent, so a batch may be larger than
+		the socket buffers. Responses are in the order of the requests. Returns false if the connection
+		broke or the server sent something unreadable.
+	**/
+	bool call(const std::vector<protocol::Request>& requests, std::vector<protocol::Response>& responses);
+
+private:
+	int			m_fd = -1;
+	std::string	m_output;
+	std::string	m_input;
+};
+
+#endif // !CLIENT_HPP
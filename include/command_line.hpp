@@ -0,0 +1,16 @@
+#pragma once
+#ifndef COMMAND_LINE_HPP
+#define COMMAND_LINE_HPP
+
+#include <cstddef>
+
+/**
+	\brief Parsing of command line arguments shared by the executables.
+**/
+namespace command_line
+{
+	// the whole of text has to be a decimal number, value is left alone otherwise
+	bool parse_count(const char* text, size_t& value);
+}
+
+#endif // !COMMAND_LINE_HPP
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef COUNTING_RESOURCE_HPP
+#define COUNTING_RESOURCE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+/**
+	\brief CountingResource class is a memory resource which counts what goes through it.
+
+	Every request is forwarded to the upstream resource. Put it in front of an arena
+	to see how much a single tokenize call allocates, or in front of the default
+	resource to measure the tokenizer without changing its behaviour.
+**/
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+	struct Stats
+	{
+		size_t	m_allocations	= 0,
+				m_deallocations	= 0,
+				m_bytes			= 0,	// allocated in total
+				m_bytes_in_use	= 0,
+				m_peak_bytes	= 0;	// the most bytes in use at once
+	};
+
+	explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: m_upstream(upstream)
+	{}
+
+	Stats stats() const;
+
+	// starts counting from zero, bytes in use are kept so later deallocations balance
+	void reset_stats();
+
+	std::pmr::memory_resource* upstream() const { return m_upstream; }
+
+private:
+	std::pmr::memory_resource*	m_upstream;
+
+	std::atomic<size_t>			m_allocations	{ 0 },
+								m_deallocations	{ 0 },
+								m_bytes			{ 0 },
+								m_bytes_in_use	{ 0 },
+								m_peak_bytes	{ 0 };
+
+	void*	do_allocate(size_t bytes, size_t alignment) override;
+	void	do_deallocate(void* p, size_t bytes, size_t alignment) override;
+	bool	do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+#endif // !COUNTING_RESOURCE_HPP
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef EVALUATOR_HPP
+#define EVALUATOR_HPP
+
+#include <expression.hpp>
+#include <region.hpp>
+#include <value.hpp>
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+	\brief Evaluator class runs expressions and keeps the variables of a session.
+
+	Everything a line allocates, its constants, temporaries and result, comes from a
+	scratch Region which is rolled back when the next line starts. An assigned value
+	is copied to the session region, the old value of the variable is left behind as
+	garbage. Once the garbage outweighs the live values, the live ones are copied to
+	a second region and the first one is cleared, so nothing is ever freed one by one.
+
+	Integers are 64 bits, an integer result which doesn't fit becomes a floating.
+**/
+class Evaluator
+{
+public:
+	explicit Evaluator(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+	/**
+		\brief Runs one line, an expression or an assignment with = or a compound operator.
+
+		result stays valid until the next call of run(). An assignment results in the
+		assigned value. Returns false and sets error if the line can't be parsed or
+		evaluated. ParseError::m_token is relative to begin, it is end - begin for
+		errors of evaluation.
+	**/
+	bool run(const Token* begin, const Token* end, Value& result, ParseError& error);
+
+	// evaluates compiled code, temporaries are allocated from the scratch region
+	bool evaluate(const Expression& expression, Value& result, std::string& error);
+
+	// the value is copied to the session region
+	void assign(std::string_view name, Value value);
+	const Value* variable(std::string_view name) const;
+
+	Region& scratch() { return m_scratch; }
+
+	// bytes of the session region in use, live values and garbage
+	size_t session_bytes() const { return m_generations[m_generation].bytes_used(); }
+
+	/**
+		\brief Applies a unary or binary operator.
+
+		Binary operators take a and b, unary ones only a. New strings and big integers
+		are allocated from resource. Returns false and sets error on a type mismatch or
+		a division by zero.
+	**/
+	static bool apply(
+		Expression::Op op,
+		Value a,
+		Value b,
+		std::pmr::memory_resource* resource,
+		Value& result,
+		std::string& error
+	);
+
+private:
+	Region									m_scratch;
+	Region									m_generations[2];
+	size_t									m_generation	= 0;
+	size_t									m_live_bytes	= 0,
+											m_garbage_bytes	= 0;
+
+	std::map<std::string, Value, std::less<>>	m_variables;
+	std::vector<Value>						m_stack;
+	Expression								m_expression;
+
+	void collect();
+};
+
+// quotient rounded towards negative infinity, b is not 0
+int64_t floor_divide(int64_t a, int64_t b);
+
+// base ** exponent for exponent >= 0, false if the result doesn't fit 64 bits
+bool integer_power(int64_t base, int64_t exponent, int64_t& result);
+
+#endif // !EVALUATOR_HPP
@@ -0,0 +1,113 @@
+#pragma once
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+#include <token.hpp>
+#include <value.hpp>
+#include <parallel_parse.hpp>
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+	\brief Expression class is an expression compiled to code for a stack machine.
+
+	Operators from the loosest to the tightest binding:
+		||	&&	|	^	&	== !=	< <= > >=	<< >>	+ -	* / // %	unary - + ! ~	**
+	All of them are left associative except ** which is right associative, so
+	-2 ** 2 is -4 and 2 ** -1 is 0.5. The identifiers true, false and nil are constants,
+	other identifiers are variables.
+
+	The tokenizer reads "2 -3" as the literals 2 and -3, a signed literal after an
+	operand is taken as a subtraction.
+**/
+class Expression
+{
+public:
+	enum class Op : uint8_t
+	{
+		constant,		// pushes constants()[operand]
+		variable,		// pushes the value of names()[operand]
+
+		negate,
+		logical_not,
+		bit_not,
+
+		add,
+		subtract,
+		multiply,
+		divide,
+		floor_divide,
+		modulo,
+		power,
+
+		equal,
+		not_equal,
+		less,
+		less_equal,
+		greater,
+		greater_equal,
+
+		bit_and,
+		bit_or,
+		bit_xor,
+		shift_left,
+		shift_right,
+
+		jump_if_false,	// && : if the top is false replaces it with false and jumps to operand, else pops it
+		jump_if_true,	// || : the same with true
+		to_boolean,
+	};
+
+	struct Instruction
+	{
+		Op			m_op;
+		uint32_t	m_operand	= 0;
+	};
+
+	/**
+		\brief Compiles the expression made of tokens [begin, end).
+
+		Long constants are allocated from resource, which has to outlive the use of
+		the compiled code. ParseError::m_token is relative to begin.
+	**/
+	std::optional<ParseError> compile(const Token* begin, const Token* end, std::pmr::memory_resource* resource);
+
+	const std::vector<Instruction>&	code()		const { return m_code; }
+	const std::vector<Value>&		constants()	const { return m_constants; }
+	const std::vector<std::string>&	names()		const { return m_names; }
+
+	// the deepest the stack gets while running the code
+	size_t max_depth() const { return m_max_depth; }
+
+	// the operator as it is written, "operator" for the other instructions
+	static const char* symbol(Op op);
+
+private:
+	std::vector<Instruction>	m_code;
+	std::vector<Value>			m_constants;
+	std::vector<std::string>	m_names;
+	size_t						m_max_depth	= 0;
+
+	const Token*				m_begin		= nullptr;
+	const Token*				m_cur		= nullptr;
+	const Token*				m_end		= nullptr;
+	std::pmr::memory_resource*	m_resource	= nullptr;
+	std::optional<ParseError>	m_error;
+	size_t						m_depth		= 0;
+
+	void parse(int min_power);
+	void parse_prefix();
+	void parse_infix(int min_power);
+	// a literal of the magnitude of a signed number token
+	bool push_number(const Token& token, std::string_view digits);
+
+	void emit(Op op, uint32_t operand = 0);
+	void fail(const Token* token, std::string message);
+};
+
+#endif // !EXPRESSION_HPP
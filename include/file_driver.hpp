@@ -0,0 +1,56 @@
+#pragma once
+#ifndef FILE_DRIVER_HPP
+#define FILE_DRIVER_HPP
+
+#include <token.hpp>
+#include <tokenizer.hpp>
+#include <thread_pool.hpp>
+#include <file_reader.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+	\brief FileResult struct is the outcome of tokenizing one file.
+**/
+struct FileResult
+{
+	std::string			m_path;
+	std::pmr::vector<Token>	m_tokens;
+
+	double				m_read_ms		= 0,		// from queueing the read to its completion
+						m_tokenize_ms	= 0;
+	bool				m_ok			= false;	// false if the file couldn't be read
+};
+
+/**
+	\brief FileDriver class tokenizes many files on a work-stealing ThreadPool.
+
+	Files are read ahead by a FileReader and scheduled largest first so a big file
+	picked up last doesn't leave the other workers idle at the end. Every worker keeps
+	its own Tokenizer between files and runs. Results come back in the order of the
+	given paths.
+**/
+class FileDriver
+{
+public:
+	// 0 threads means one per hardware thread
+	explicit FileDriver(size_t threads = 0);
+
+	std::vector<FileResult> run(const std::vector<std::string>& paths);
+
+private:
+	struct Worker
+	{
+		Tokenizer	m_tokenizer;
+	};
+
+	ThreadPool			m_pool;
+	FileReader			m_reader;
+	std::vector<Worker>	m_workers;
+
+	void process(Worker& worker, FileResult& result, std::string_view data);
+};
+
+#endif // !FILE_DRIVER_HPP
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef FILE_READER_HPP
+#define FILE_READER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+	\brief FileReader class reads a list of files ahead of the code consuming them.
+
+	Opens and reads are batched through io_uring where the kernel provides it, otherwise
+	a few threads do blocking open/pread calls. Every file in flight or handed out
+	occupies one buffer of a fixed pool, so read-ahead never holds more than buffers files.
+	Buffers grow to the largest file they have held and are reused after recycle().
+
+	One thread calls start() and next(), recycle() may be called from any thread.
+**/
+class FileReader
+{
+public:
+	enum class Backend
+	{
+		io_uring,
+		threads,
+	};
+
+	struct File
+	{
+		size_t				m_index		= 0;		// position in the list given to start()
+		bool				m_ok		= false;	// false if the file couldn't be opened or read
+		std::string_view	m_data;
+		double				m_read_ms	= 0;		// from submitting the read to its completion
+
+		size_t				m_buffer	= size_t(-1);
+	};
+
+	// io_uring is used when prefer_io_uring is set and the kernel supports it
+	explicit FileReader(size_t buffers = 32, size_t threads = 4, bool prefer_io_uring = true);
+	~FileReader();
+
+	FileReader(const FileReader&)				= delete;
+	FileReader& operator=(const FileReader&)	= delete;
+
+	Backend backend() const;
+
+	// files are read roughly in the given order, the previous list has to be consumed
+	void start(std::vector<std::string> paths);
+
+	/**
+		\brief Waits for the next file in order of completion.
+
+		Returns false once every file of the list has been handed out. Waits for a
+		recycle() from another thread when every buffer is handed out.
+	**/
+	bool next(File& file);
+
+	// gives the buffer of file back to the pool, file.m_data becomes invalid
+	void recycle(File& file);
+
+	struct Request
+	{
+		size_t				m_index		= 0;
+		std::string			m_path;
+		std::vector<char>*	m_buffer	= nullptr;
+		size_t				m_buffer_index = 0;
+		size_t				m_size		= 0;		// bytes read so far
+		int					m_fd		= -1;
+		bool				m_ok		= false;
+
+		std::chrono::steady_clock::time_point m_submitted;
+	};
+
+	class Engine;
+
+private:
+	std::unique_ptr<Engine>					m_engine;
+
+	std::vector<std::unique_ptr<std::vector<char>>> m_buffers;
+	std::vector<std::unique_ptr<Request>>	m_requests;		// one per buffer
+
+	std::vector<std::string>				m_paths;
+	size_t									m_next_path	= 0;
+	size_t									m_in_flight	= 0;
+	size_t									m_handed_out= 0;
+
+	std::mutex								m_free_mutex;
+	std::condition_variable					m_free_cv;
+	std::vector<size_t>						m_free;			// buffers ready for a new read
+
+	void submit_reads();
+};
+
+#endif // !FILE_READER_HPP
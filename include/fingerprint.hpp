@@ -0,0 +1,102 @@
+#pragma once
+#ifndef FINGERPRINT_HPP
+#define FINGERPRINT_HPP
+
+#include <token.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+	\brief Fingerprinter class reduces a token stream to a few hashes for clone detection.
+
+	Every token except commentaries is hashed from its type and value, so spacing and
+	comments don't change the result. Consecutive k token hashes make a rolling k-gram
+	hash and winnowing keeps the smallest k-gram hash of every window of w k-grams.
+	Two streams sharing a run of at least w + k - 1 tokens share a fingerprint.
+
+	Feed it with add() or let a Tokenizer feed it while lexing, tokens are not kept.
+**/
+class Fingerprinter
+{
+public:
+	struct Fingerprint
+	{
+		uint64_t	m_hash		= 0;
+		size_t		m_position	= 0;	// of the first token of the k-gram, commentaries not counted
+	};
+
+	explicit Fingerprinter(size_t k = 8, size_t window = 16);
+
+	void add(const Token& token);
+
+	// a stream shorter than k tokens gets a single fingerprint here
+	void finish();
+	void reset();
+
+	// hash of the whole normalized stream, equal for exact clones
+	uint64_t digest()		const { return m_digest; }
+	size_t token_count()	const { return m_count; }
+
+	const std::vector<Fingerprint>& fingerprints() const { return m_fingerprints; }
+
+	static uint64_t hash(const Token& token);
+
+private:
+	size_t						m_k;
+	size_t						m_window_size;
+	uint64_t					m_base_power	= 1;	// of the rolling hash, base^k
+
+	std::vector<uint64_t>		m_recent;		// last k token hashes
+	uint64_t					m_gram			= 0;
+	size_t						m_count			= 0;
+	uint64_t					m_digest		= 0;
+
+	std::vector<Fingerprint>	m_window;		// last window k-gram hashes
+	size_t						m_window_end	= 0;
+	size_t						m_min			= 0;
+
+	std::vector<Fingerprint>	m_fingerprints;
+
+	void winnow(uint64_t hash, size_t position);
+};
+
+/**
+	\brief CloneIndex class finds documents which share fingerprints in one pass over a corpus.
+
+	Only the fingerprints of every document are kept. Similarity is the Jaccard index of
+	the fingerprint sets of two documents, exact clones are told apart by their digest.
+**/
+class CloneIndex
+{
+public:
+	struct Match
+	{
+		size_t	m_document		= 0;	// in order of add()
+		double	m_similarity	= 0;
+		bool	m_exact			= false;
+	};
+
+	/**
+		\brief Adds a document and returns the earlier ones at least min_similarity alike.
+
+		Matches are sorted from the most similar.
+	**/
+	std::vector<Match> add(const Fingerprinter& document, double min_similarity = 0.5);
+
+	size_t size() const { return m_documents.size(); }
+
+private:
+	struct Document
+	{
+		uint64_t	m_digest		= 0;
+		size_t		m_tokens		= 0;
+		size_t		m_fingerprints	= 0;	// distinct ones
+	};
+
+	std::vector<Document>								m_documents;
+	std::unordered_map<uint64_t, std::vector<uint32_t>>	m_postings;	// fingerprint -> documents
+};
+
+#endif // !FINGERPRINT_HPP
@@ -0,0 +1,128 @@
+#pragma once
+#ifndef PARALLEL_PARSE_HPP
+#define PARALLEL_PARSE_HPP
+
+#include <token.hpp>
+#include <thread_pool.hpp>
+
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+	\brief StatementRange struct is a top-level statement, tokens [m_begin, m_end)
+	without the closing ';'.
+**/
+struct StatementRange
+{
+	size_t	m_begin	= 0,
+			m_end	= 0;
+};
+
+struct ParseError
+{
+	size_t		m_statement	= 0;	// index of the statement
+	size_t		m_token		= 0;	// index of the token in the whole stream
+	std::string	m_message;
+};
+
+/**
+	\brief Splits tokens at every ';' which is not inside of brackets.
+
+	Empty statements are skipped. Unbalanced closing brackets don't take the depth below zero.
+**/
+std::vector<StatementRange> split_statements(const std::pmr::vector<Token>& tokens);
+
+/**
+	\brief ParsedProgram struct holds the statements of a program in source order.
+
+	Nodes may point into the arenas, which live as long as the program does.
+**/
+template<typename Node>
+struct ParsedProgram
+{
+	std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> m_arenas;
+
+	std::vector<StatementRange>	m_ranges;
+	std::vector<Node>			m_statements;
+	std::vector<ParseError>		m_errors;		// ordered by statement, as a sequential parse reports them
+};
+
+/**
+	\brief Parses the top-level statements of tokens independently of each other.
+
+	parse is called as
+		std::optional<ParseError> parse(const Token* first, const Token* last,
+										std::pmr::memory_resource* arena, Node& node)
+	for every statement, ParseError::m_token relative to first. It may run on any worker
+	of pool at the same time as other statements, with an arena owned by that worker.
+	Without a pool the statements are parsed in order on the calling thread.
+**/
+template<typename Node, typename Parse>
+ParsedProgram<Node> parallel_parse(const std::pmr::vector<Token>& tokens, Parse parse, ThreadPool* pool = nullptr)
+{
+	ParsedProgram<Node> program;
+	program.m_ranges = split_statements(tokens);
+
+	auto count = program.m_ranges.size();
+	program.m_statements.resize(count);
+
+	std::vector<std::optional<ParseError>> errors(count);
+
+	auto workers = pool ? pool->size() : 1;
+	for (size_t i = 0; i < workers; ++i)
+		program.m_arenas.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>());
+
+	auto parse_statement = [&](size_t index, size_t worker)
+	{
+		auto& range = program.m_ranges[index];
+		auto first = tokens.data() + range.m_begin;
+		auto last = tokens.data() + range.m_end;
+
+		errors[index] = parse(first, last, program.m_arenas[worker].get(), program.m_statements[index]);
+		if (errors[index])
+		{
+			errors[index]->m_statement = index;
+			errors[index]->m_token += range.m_begin;
+		}
+	};
+
+	if (!pool || count < 2)
+	{
+		for (size_t i = 0; i < count; ++i)
+			parse_statement(i, 0);
+	}
+	else
+	{
+		// a few tasks per worker so stealing can even out statements of different size
+		auto per_task = std::max<size_t>(1, tokens.size() / (workers * 4));
+
+		for (size_t begin = 0; begin < count;)
+		{
+			size_t end = begin, size = 0;
+			while (end < count && (end == begin || size < per_task))
+			{
+				size += program.m_ranges[end].m_end - program.m_ranges[end].m_begin;
+				++end;
+			}
+
+			pool->submit([&parse_statement, begin, end](size_t worker)
+			{
+				for (auto i = begin; i < end; ++i)
+					parse_statement(i, worker);
+			});
+			begin = end;
+		}
+		pool->wait();
+	}
+
+	for (auto& error : errors)
+		if (error)
+			program.m_errors.push_back(std::move(*error));
+
+	return program;
+}
+
+#endif // !PARALLEL_PARSE_HPP
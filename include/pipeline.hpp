@@ -0,0 +1,73 @@
+#pragma once
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <token.hpp>
+#include <tokenizer.hpp>
+#include <spsc_ring.hpp>
+
+#include <atomic>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+	\brief TokenPipeline class runs a Tokenizer on its own thread and hands tokens over in batches.
+
+	The producer thread feeds the input to the tokenizer chunk by chunk and pushes
+	batches of batch_size tokens into a bounded SpscRing. When the ring is full the
+	producer waits, so no more than ring_capacity batches are ever in flight.
+	Exactly one thread may call pop().
+**/
+class TokenPipeline
+{
+public:
+	using Batch = std::pmr::vector<Token>;
+
+	explicit TokenPipeline(
+		size_t batch_size		= 512,
+		size_t ring_capacity	= 64,
+		size_t chunk_size		= 64 * 1024
+	);
+	~TokenPipeline();
+
+	TokenPipeline(const TokenPipeline&)				= delete;
+	TokenPipeline& operator=(const TokenPipeline&)	= delete;
+
+	/**
+		\brief Starts tokenizing input on the producer thread.
+
+		input has to stay alive until pop() returned false or join() or stop() was called.
+		A producer still working on the previous input is stopped first.
+	**/
+	void start(std::string_view input);
+
+	/**
+		\brief Waits for the next batch.
+
+		Returns false once every token of the input has been handed out.
+	**/
+	bool pop(Batch& batch);
+
+	void join();
+
+	// makes the producer give up the rest of the input, drops the batches not popped yet and joins
+	void stop();
+
+private:
+	Tokenizer			m_tokenizer;
+	SpscRing<Batch>		m_ring;
+
+	size_t				m_batch_size;
+	size_t				m_chunk_size;
+
+	std::thread			m_producer;
+	std::atomic<bool>	m_done{ false };
+	std::atomic<bool>	m_stop{ false };
+
+	void produce(std::string_view input);
+	// false once the producer is told to stop
+	bool push_batch(Batch& batch);
+};
+
+#endif // !PIPELINE_HPP
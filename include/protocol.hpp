@@ -0,0 +1,86 @@
+#pragma once
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <token.hpp>
+#include <parallel_parse.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+	\brief Binary encoding of tokens and of the frames spoken by Server.
+
+	Every frame starts with its length as a 32-bit little-endian number, not counting
+	those 4 bytes. Numbers inside of frames and tokens are LEB128 varints.
+
+	request:	length, varint id, u8 op, source text
+	response:	length, varint id, u8 status, varint token count, tokens,
+				[varint statement count, (varint begin, varint end)...]	for Op::statements
+	token:		u8 type, u8 flags, varint line, varint column, varint size, value
+**/
+namespace protocol
+{
+	constexpr size_t max_frame = 256 * 1024 * 1024;
+
+	// returned for a frame length above max_frame, the stream can't be followed past it
+	constexpr size_t broken_stream = size_t(-1);
+
+	enum class Op : uint8_t
+	{
+		tokenize	= 1,
+		statements	= 2,	// tokens and the ranges of top-level statements
+	};
+
+	enum class Status : uint8_t
+	{
+		ok			= 0,
+		bad_request	= 1,
+	};
+
+	struct Request
+	{
+		uint64_t			m_id	= 0;
+		Op					m_op	= Op::tokenize;
+		std::string_view	m_source;
+	};
+
+	struct Response
+	{
+		uint64_t					m_id		= 0;
+		Status						m_status	= Status::ok;
+		std::pmr::vector<Token>		m_tokens;
+		std::vector<StatementRange>	m_statements;
+	};
+
+	void write_varint(std::string& out, uint64_t value);
+	bool read_varint(const char*& cur, const char* end, uint64_t& value);
+
+	void write_token(std::string& out, const Token& token);
+	bool read_token(const char*& cur, const char* end, Token& token);
+
+	void write_request(std::string& out, const Request& request);
+
+	// frames are appended to out
+	void write_response(
+		std::string& out,
+		uint64_t id,
+		Status status,
+		const std::pmr::vector<Token>& tokens,
+		const std::vector<StatementRange>* statements = nullptr
+	);
+
+	/**
+		\brief Reads the frame at the start of buffer.
+
+		Returns the size of the frame, 0 if buffer doesn't hold all of it yet or
+		broken_stream. malformed is set for frames whose content can't be read,
+		their size is still returned so the reader can skip them.
+	**/
+	size_t read_request(std::string_view buffer, Request& request, bool& malformed);
+	size_t read_response(std::string_view buffer, Op op, Response& response, bool& malformed);
+}
+
+#endif // !PROTOCOL_HPP
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef REGION_HPP
+#define REGION_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+/**
+	\brief Region class is a bump allocator which frees everything past a mark at once.
+
+	deallocate() does nothing, memory comes back only through rollback() and clear().
+	Blocks are kept for reuse after a rollback, so a region which is rolled back
+	after every unit of work stops calling its upstream once it has grown to the
+	size that work needs.
+**/
+class Region : public std::pmr::memory_resource
+{
+public:
+	struct Mark
+	{
+		size_t	m_block	= 0,
+				m_used	= 0;
+	};
+
+	explicit Region(
+		size_t						block_size	= 64 * 1024,
+		std::pmr::memory_resource*	upstream	= std::pmr::new_delete_resource()
+	);
+	~Region();
+
+	Region(const Region&)				= delete;
+	Region& operator=(const Region&)	= delete;
+
+	Mark mark() const { return { m_current, m_blocks.empty() ? 0 : m_blocks[m_current].m_used }; }
+
+	// frees everything allocated after mark was taken
+	void rollback(Mark mark);
+	void clear() { rollback(Mark()); }
+
+	size_t bytes_used()		const;
+	size_t bytes_reserved()	const;
+
+private:
+	struct Block
+	{
+		char*	m_data	= nullptr;
+		size_t	m_size	= 0,
+				m_used	= 0;
+	};
+
+	std::pmr::memory_resource*	m_upstream;
+	size_t						m_block_size;
+
+	std::vector<Block>			m_blocks;		// blocks after m_current are empty
+	size_t						m_current	= 0;
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+#endif // !REGION_HPP
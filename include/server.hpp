@@ -0,0 +1,82 @@
+#pragma once
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <tokenizer.hpp>
+#include <thread_pool.hpp>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+	\brief Server class answers tokenize requests on a Unix domain socket.
+
+	Frames are described in protocol.hpp. run() waits on every connection with epoll
+	and submits a ThreadPool task for each connection with data ready. The task reads
+	what has arrived, answers all complete frames together with a single write and
+	re-arms the connection, so any number of idle connections costs no worker.
+	A connection is handled by at most one task at a time, so its answers keep
+	the order of its requests. Workers keep their Tokenizer with its compiled rules
+	and their buffers between tasks.
+**/
+class Server
+{
+public:
+	// 0 threads means one per hardware thread
+	explicit Server(std::string socket_path, size_t threads = 0);
+	~Server();
+
+	Server(const Server&)				= delete;
+	Server& operator=(const Server&)	= delete;
+
+	// creates the socket, false with errno set if that fails
+	bool listen();
+
+	// accepts connections until stop() is called
+	void run();
+
+	// may be called from any thread and from a signal handler
+	void stop();
+
+private:
+	struct Worker
+	{
+		Tokenizer	m_tokenizer;
+		std::string	m_input;
+		std::string	m_output;
+	};
+
+	struct Connection
+	{
+		int			m_fd	= -1;
+		std::string	m_pending;		// start of a frame which hasn't arrived in full
+	};
+
+	std::string			m_socket_path;
+	int					m_listen_fd		= -1;
+	int					m_epoll_fd		= -1;
+	int					m_stop_pipe[2]	= { -1, -1 };
+
+	ThreadPool			m_pool;
+	std::vector<Worker>	m_workers;
+
+	std::mutex			m_connections_mutex;
+	std::map<int, std::unique_ptr<Connection>> m_connections;
+
+	// the listen socket isn't watched while accept() is out of descriptors
+	std::atomic<bool>	m_accept_paused{ false };
+
+	void accept_all();
+	// answers the frames which have arrived, false if the connection has to be closed
+	bool serve(Worker& worker, Connection& connection);
+	void close_connection(int fd);
+	// false if the connection has to be closed
+	bool answer(Worker& worker, std::string_view frames, size_t& used);
+};
+
+#endif // !SERVER_HPP
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+	\brief SpscRing class is a bounded lock-free queue for exactly one producer and one consumer thread.
+
+	Capacity is rounded up to a power of two. Head and tail live on their own cache lines,
+	each side also keeps a cached copy of the other side's index so it touches the shared
+	line only when the ring looks full or empty.
+**/
+template<typename T>
+class SpscRing
+{
+public:
+	static constexpr size_t cache_line = 64;
+
+	explicit SpscRing(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		m_slots.resize(size);
+		m_mask = size - 1;
+	}
+
+	SpscRing(const SpscRing&)				= delete;
+	SpscRing& operator=(const SpscRing&)	= delete;
+
+	size_t capacity() const { return m_slots.size(); }
+
+	// producer side
+	bool try_push(T&& value)
+	{
+		auto tail = m_tail.value.load(std::memory_order_relaxed);
+
+		if (tail - m_head_cache == m_slots.size())
+		{
+			m_head_cache = m_head.value.load(std::memory_order_acquire);
+			if (tail - m_head_cache == m_slots.size())
+				return false;
+		}
+
+		m_slots[tail & m_mask] = std::move(value);
+		m_tail.value.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// consumer side
+	std::optional<T> try_pop()
+	{
+		auto head = m_head.value.load(std::memory_order_relaxed);
+
+		if (head == m_tail_cache)
+		{
+			m_tail_cache = m_tail.value.load(std::memory_order_acquire);
+			if (head == m_tail_cache)
+				return std::nullopt;
+		}
+
+		std::optional<T> value(std::move(m_slots[head & m_mask]));
+		m_head.value.store(head + 1, std::memory_order_release);
+
+		return value;
+	}
+
+	bool empty() const
+	{
+		return	m_head.value.load(std::memory_order_acquire) ==
+				m_tail.value.load(std::memory_order_acquire);
+	}
+
+private:
+	struct alignas(cache_line) Index
+	{
+		std::atomic<size_t> value{ 0 };
+	};
+
+	std::vector<T>	m_slots;
+	size_t			m_mask = 0;
+
+	Index			m_head;								// next slot to pop, written by the consumer
+	alignas(cache_line) size_t m_tail_cache = 0;		// consumer's copy of m_tail
+
+	Index			m_tail;								// next slot to push, written by the producer
+	alignas(cache_line) size_t m_head_cache = 0;		// producer's copy of m_head
+};
+
+#endif // !SPSC_RING_HPP
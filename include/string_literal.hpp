@@ -0,0 +1,71 @@
+#pragma once
+#ifndef STRING_LITERAL_HPP
+#define STRING_LITERAL_HPP
+
+#include <token.hpp>
+
+#include <array>
+#include <string>
+#include <string_view>
+
+/**
+	\brief Decoding of string literals.
+
+	The tokenizer keeps string tokens exactly as they are written in the source,
+	quotes and escape sequences included. The decoded value is produced only on request.
+**/
+namespace string_literal
+{
+	// character an escape sequence stands for, indexed by the byte after the backslash, 0 if invalid
+	extern const std::array<char, 256> escape_table;
+
+	/**
+		\brief Appends the value of literal to out.
+
+		The quotes around literal are dropped if present. Text between backslashes is
+		copied in bulk, unknown escape sequences are kept as written.
+	**/
+	void decode(std::string_view literal, std::string& out);
+
+	inline std::string decode(std::string_view literal)
+	{
+		std::string value;
+		decode(literal, value);
+		return value;
+	}
+
+	/**
+		\brief Appends value to out as a literal the tokenizer reads back as value.
+
+		The literal is quoted, the characters escape_table produces are written as
+		escape sequences and every other byte is copied as it is.
+	**/
+	void encode(std::string_view value, std::string& out);
+
+	inline std::string encode(std::string_view value)
+	{
+		std::string literal;
+		encode(value, literal);
+		return literal;
+	}
+
+	// true if text is a complete literal the tokenizer accepts as a string token
+	bool is_literal(std::string_view text);
+
+	// value of a string token
+	inline std::string value(const Token& token)
+	{
+		std::string_view literal = token.m_value;
+		if (!token.m_has_escapes)
+		{
+			if (!literal.empty() && literal.front() == '"')
+				literal.remove_prefix(1);
+			if (!literal.empty() && literal.back() == '"')
+				literal.remove_suffix(1);
+			return std::string(literal);
+		}
+		return decode(literal);
+	}
+}
+
+#endif // !STRING_LITERAL_HPP
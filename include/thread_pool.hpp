@@ -0,0 +1,63 @@
+#pragma once
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+	\brief ThreadPool class is a work-stealing pool of worker threads.
+
+	Every worker owns a queue. Tasks are spread over the queues round-robin, a worker
+	takes tasks from the front of its own queue in submission order and, once it runs dry,
+	steals from the back of the other queues. Tasks get the index of the worker running
+	them, so callers can keep per-worker state in a plain vector.
+**/
+class ThreadPool
+{
+public:
+	using Task = std::function<void(size_t worker)>;
+
+	// 0 threads means one per hardware thread
+	explicit ThreadPool(size_t threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&)				= delete;
+	ThreadPool& operator=(const ThreadPool&)	= delete;
+
+	size_t size() const { return m_workers.size(); }
+
+	void submit(Task task);
+
+	// blocks until every submitted task has finished
+	void wait();
+
+private:
+	struct alignas(64) Queue
+	{
+		std::mutex			mutex;
+		std::deque<Task>	tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>>	m_queues;
+	std::vector<std::thread>			m_workers;
+	size_t								m_next_queue = 0;
+
+	std::mutex							m_mutex;
+	std::condition_variable				m_work_cv;		// signalled when tasks are submitted
+	std::condition_variable				m_idle_cv;		// signalled when the last task finishes
+	size_t								m_queued	= 0;	// tasks sitting in queues
+	size_t								m_unfinished= 0;	// tasks queued or running
+	bool								m_stop		= false;
+
+	void run(size_t worker);
+	bool pop_task(size_t worker, Task& task);
+};
+
+#endif // !THREAD_POOL_HPP
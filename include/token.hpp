@@ -3,14 +3,21 @@
 #define TOKEN_HPP
 
 
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /**
 	\brief Token class is represents an lexem with some semantic meanings with it.
+
+	Token is allocator-aware, a std::pmr::vector<Token> allocates the values of its
+	tokens from its own memory resource.
 **/
 struct Token
 {
+	using allocator_type = std::pmr::polymorphic_allocator<char>;
+
 	enum class Type
 	{
 		empty = -2,
@@ -33,15 +40,32 @@ struct Token
 	size_t		m_line	= 0,
 				m_col	= 0;
 	Type		m_type	= Type::empty;
-	std::string m_value	= "";
+	std::pmr::string m_value;
+
+	bool		m_has_escapes = false;	// string literal contains escape sequences
 
 	Token(
-		size_t		line	= 0, 
-		size_t		column	= 0, 
-		Type		type	= Type::empty,
-		std::string value	= ""
+		size_t				line	= 0, 
+		size_t				column	= 0, 
+		Type				type	= Type::empty,
+		std::string_view	value	= "",
+		const allocator_type& alloc	= {}
 	)	
-		: m_type(type), m_value(value), m_line(line), m_col(column)
+		: m_type(type), m_value(value, alloc), m_line(line), m_col(column)
+	{}
+
+	Token(const Token&)				= default;
+	Token(Token&&)					= default;
+	Token& operator=(const Token&)	= default;
+	Token& operator=(Token&&)		= default;
+
+	Token(const Token& other, const allocator_type& alloc)
+		:	m_line(other.m_line), m_col(other.m_col), m_type(other.m_type),
+			m_value(other.m_value, alloc), m_has_escapes(other.m_has_escapes)
+	{}
+	Token(Token&& other, const allocator_type& alloc)
+		:	m_line(other.m_line), m_col(other.m_col), m_type(other.m_type),
+			m_value(std::move(other.m_value), alloc), m_has_escapes(other.m_has_escapes)
 	{}
 };
 
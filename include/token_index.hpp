@@ -0,0 +1,110 @@
+#pragma once
+#ifndef TOKEN_INDEX_HPP
+#define TOKEN_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+	\brief TokenIndex class maps the text of tokens to where they appear in a set of files.
+
+	The index lives in a single file which is memory-mapped for queries. Every token
+	except commentaries is a term. Postings of a term are sorted by file, line and
+	column and stored as varint deltas. Files are identified by path and remembered
+	with their size and modification time, so update() tokenizes only the files which
+	changed since the last update. It streams the old postings term by term out of the
+	mapped index, merged with those of the changed files, so memory holds the changed
+	files and the term table but not the postings of the unchanged ones.
+
+	index file:	header, postings, files, names, terms
+	header:		"cppidx01", u64 offsets of files, names and terms, u64 file and term count
+	file:		varint path size, path, varint size, varint mtime in ns
+	term:		u64 name offset, u64 postings offset, u32 name size, u32 posting count
+
+	Offsets are from the start of the file, numbers outside of varints are little endian.
+**/
+class TokenIndex
+{
+public:
+	struct Location
+	{
+		std::string_view	m_file;		// valid until the next update() or open()
+		size_t				m_line	= 0,
+							m_col	= 0;
+	};
+
+	struct UpdateStats
+	{
+		size_t	m_tokenized	= 0,	// files read and tokenized again
+				m_reused	= 0,	// files whose postings were copied
+				m_failed	= 0;	// files which couldn't be read, they are left out
+	};
+
+	explicit TokenIndex(std::string path);
+	~TokenIndex();
+
+	TokenIndex(const TokenIndex&)				= delete;
+	TokenIndex& operator=(const TokenIndex&)	= delete;
+
+	// maps the index file, false if it is missing or damaged
+	bool open();
+	void close();
+
+	/**
+		\brief Makes the index cover exactly the given files and maps it.
+
+		The new index is written to a unique temp file next to the old one and renamed
+		over it, readers of the old file and concurrent updates are not disturbed. 0 threads means one per hardware thread.
+	**/
+	bool update(const std::vector<std::string>& files, size_t threads = 0);
+
+	const UpdateStats& last_update() const { return m_stats; }
+
+	// every use of text in file, line and column order
+	std::vector<Location> find(std::string_view text) const;
+
+	size_t file_count()	const { return m_files.size(); }
+	size_t term_count()	const { return m_term_count; }
+
+private:
+	struct File
+	{
+		std::string	m_path;
+		uint64_t	m_size	= 0,
+					m_mtime	= 0;
+	};
+
+	struct Posting
+	{
+		uint32_t	m_file	= 0,
+					m_line	= 0,
+					m_col	= 0;
+
+		bool operator<(const Posting& other) const
+		{
+			if (m_file != other.m_file)	return m_file < other.m_file;
+			if (m_line != other.m_line)	return m_line < other.m_line;
+			return m_col < other.m_col;
+		}
+	};
+
+	std::string			m_path;
+	int					m_fd		= -1;
+	const char*			m_data		= nullptr;
+	size_t				m_size		= 0;
+
+	std::vector<File>	m_files;
+	const char*			m_names		= nullptr;
+	const char*			m_terms		= nullptr;
+	size_t				m_term_count= 0;
+
+	UpdateStats			m_stats;
+
+	std::string_view term_name(size_t term) const;
+	// appends the postings of a term, false if they are damaged
+	bool decode(size_t term, std::vector<Posting>& postings) const;
+};
+
+#endif // !TOKEN_INDEX_HPP
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef TOKEN_SPOOL_HPP
+#define TOKEN_SPOOL_HPP
+
+#include <tokenizer.hpp>
+
+#include <cstdint>
+#include <istream>
+#include <memory_resource>
+#include <string>
+
+/**
+	\brief TokenSpool class holds a token stream of any length within a memory ceiling.
+
+	Tokens are kept in memory until they take more than memory_limit bytes, then all of
+	them are written to an unlinked temp file in the binary form of protocol.hpp and
+	memory is reused for the following tokens. Readers go through the spilled tokens
+	chunk by chunk and then through the resident ones, so memory use stays flat
+	however long the input is.
+
+	The limit counts the tokens and their values, the vector holding them may take
+	up to as much again.
+**/
+class TokenSpool
+{
+public:
+	// bytes of encoded tokens written and read back at once
+	static constexpr size_t chunk_size = 1024 * 1024;
+
+	// an empty temp_dir means std::filesystem::temp_directory_path()
+	explicit TokenSpool(
+		size_t						memory_limit	= 64 * 1024 * 1024,
+		std::pmr::memory_resource*	resource		= std::pmr::get_default_resource(),
+		std::string					temp_dir		= {}
+	);
+	~TokenSpool();
+
+	TokenSpool(const TokenSpool&)				= delete;
+	TokenSpool& operator=(const TokenSpool&)	= delete;
+
+	/**
+		\brief Moves tokens to the end of the spool and leaves tokens empty.
+
+		Returns false if the temp file couldn't be created or written, the spool
+		can't be used afterwards.
+	**/
+	bool append(std::pmr::vector<Token>& tokens);
+
+	/**
+		\brief Tokenizes the whole stream into the spool, input_size bytes at a time.
+
+		The tokenizer is reset first and left finished.
+	**/
+	bool tokenize(std::istream& input, Tokenizer& tokenizer, size_t input_size = 64 * 1024);
+
+	void clear();
+
+	size_t size()			const { return m_spilled_tokens + m_resident.size(); }
+	size_t resident_bytes()	const { return m_resident_bytes; }
+	uint64_t spilled_bytes()const { return m_spilled_bytes; }
+	bool failed()			const { return m_failed; }
+
+	/**
+		\brief Reader class goes through the tokens of a spool in order.
+
+		Appending to the spool while reading it invalidates the reader.
+	**/
+	class Reader
+	{
+	public:
+		// false at the end of the spool or if the temp file can't be read
+		bool next(Token& token);
+		bool failed() const { return m_failed; }
+
+	private:
+		friend TokenSpool;
+		explicit Reader(const TokenSpool& spool) : m_spool(&spool) {}
+
+		const TokenSpool*	m_spool;
+		uint64_t			m_offset	= 0;	// of the next chunk in the temp file
+		std::string			m_chunk;
+		size_t				m_pos		= 0;	// in m_chunk
+		size_t				m_resident	= 0;	// next resident token
+		bool				m_failed	= false;
+
+		bool read_chunk();
+	};
+
+	Reader reader() const { return Reader(*this); }
+
+private:
+	size_t					m_memory_limit;
+	std::string				m_temp_dir;
+	int						m_fd				= -1;
+
+	std::pmr::vector<Token>	m_resident;
+	size_t					m_resident_bytes	= 0;
+
+	uint64_t				m_spilled_bytes		= 0;
+	size_t					m_spilled_tokens	= 0;
+	std::string				m_encoded;
+	bool					m_failed			= false;
+
+	bool spill();
+	bool write_chunk();
+};
+
+#endif // !TOKEN_SPOOL_HPP
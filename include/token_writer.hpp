@@ -0,0 +1,110 @@
+#pragma once
+#ifndef TOKEN_WRITER_HPP
+#define TOKEN_WRITER_HPP
+
+#include <tokenizer.hpp>
+
+#include <array>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/uio.h>
+
+/**
+	\brief TokenWriter class writes a token stream back as source text.
+
+	The minified style puts whitespace only where the tokenizer needs it to split the
+	tokens the same way again, the canonical style spaces operators, breaks lines after
+	';' and braces and indents blocks by tabs. Either way tokenizing the output gives
+	the same types and values. String literals are written as the tokenizer kept them,
+	a string token holding anything else is taken as the value and re-escaped.
+
+	Text is gathered in one preallocated buffer, values of copy_limit bytes or more are
+	pointed at where they are, and everything goes out with a single writev() per flush.
+	Those values are written before write() returns, so the tokens may be dropped after it.
+**/
+class TokenWriter
+{
+public:
+	enum class Style
+	{
+		minified,
+		canonical,
+	};
+
+	static constexpr size_t default_buffer_size	= 256 * 1024;
+	static constexpr size_t copy_limit			= 4 * 1024;
+
+	// writes to fd, which is left open
+	explicit TokenWriter(int fd, Style style = Style::minified, size_t buffer_size = default_buffer_size);
+	// appends to out
+	explicit TokenWriter(std::string& out, Style style = Style::minified, size_t buffer_size = default_buffer_size);
+	// flushes what is left
+	~TokenWriter();
+
+	TokenWriter(const TokenWriter&)				= delete;
+	TokenWriter& operator=(const TokenWriter&)	= delete;
+
+	/**
+		\brief Writes tokens as the continuation of the tokens written so far.
+
+		Returns false if writing failed, the writer can't be used afterwards.
+	**/
+	bool write(const Token* begin, const Token* end);
+	bool write(const std::pmr::vector<Token>& tokens)
+	{
+		return write(tokens.data(), tokens.data() + tokens.size());
+	}
+	bool write(const Token& token)	{ return write(&token, &token + 1); }
+
+	// ends the stream with what its last token needs and flushes
+	bool finish();
+	bool flush();
+
+	// starts a new stream, buffered text is kept
+	void reset();
+
+	bool failed()		const { return m_failed; }
+	size_t written()	const { return m_written; }
+
+private:
+	Style					m_style;
+	int						m_fd	= -1;
+	std::string*			m_out	= nullptr;
+
+	std::vector<char>		m_buffer;
+	size_t					m_used		= 0;
+	size_t					m_segment	= 0;	// start of the buffered text not in m_iov yet
+	std::vector<iovec>		m_iov;
+	bool					m_external	= false;	// m_iov points into tokens
+
+	size_t					m_written	= 0;
+	bool					m_failed	= false;
+
+	std::string				m_escaped;	// literal of a string value being written
+
+	// rules of the tokenizer, indexed by byte
+	std::array<bool, 256>	m_delimiter{};
+	std::array<bool, 256>	m_operator_start{};
+
+	// the last token written, values longer than an operator aren't needed
+	bool					m_has_prev	= false;
+	Token::Type				m_prev_type	= Token::Type::empty;
+	char					m_prev[4]	= {};
+	bool					m_prev_unary= false;
+	bool					m_prev_open	= false;	// an unterminated string, whitespace would join it
+
+	size_t					m_depth		= 0;	// open braces
+	size_t					m_nesting	= 0;	// open parentheses and square brackets
+
+	void separate(Token::Type type, std::string_view value);
+	bool minified_space(std::string_view value) const;
+
+	void append(const char* data, size_t size);
+	void append(char c);
+	void close_segment();
+};
+
+#endif // !TOKEN_WRITER_HPP
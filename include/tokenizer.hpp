@@ -3,9 +3,17 @@
 #define TOKENIZER_HPP
 
 #include <token.hpp>
+#include <fingerprint.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <istream>
+#include <memory_resource>
 #include <set>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 /**
@@ -42,9 +50,13 @@ public:
 		end
 	};
 
-	Tokenizer();
+	/**
+		Tokens, their values and the side tables are allocated from resource,
+		the rules are not.
+	**/
+	explicit Tokenizer(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
-	const std::vector<Token>&	tokens()		const
+	const std::pmr::vector<Token>&	tokens()	const
 	{
 		return m_tokens;
 	}
@@ -63,27 +75,151 @@ public:
 		m_cur_line = 1;
 		m_cur_col = 0;
 		m_state = State::new_token;
+
+		m_token_offset = 0;
+		m_fingerprinted = 0;
+		if (m_fingerprinter)
+			m_fingerprinter->reset();
+
+		m_bracket_stack.clear();
+		std::fill(std::begin(m_open_brackets), std::end(m_open_brackets), 0);
+		m_bracket_partner.clear();
+		m_bracket_errors.clear();
+	}
+
+	/**
+		\brief Resets the tokenizer and drops all of its storage,
+		further tokens are allocated from resource.
+
+		Call it before releasing the memory resource the tokenizer used so far.
+	**/
+	void reset(std::pmr::memory_resource* resource);
+
+	std::pmr::memory_resource* resource() const { return m_tokens.get_allocator().resource(); }
+
+	const std::pmr::vector<Token>& tokenize(const std::string& str);
+
+	/**
+		\brief Tokenizes a part of the input without finishing the last token.
+
+		Call it as many times as needed and finish() after the last part.
+		Parts may end anywhere except inside of an UTF-8 encoded character.
+	**/
+	void feed(std::string_view str);
+	void finish();
+
+	/**
+		\brief Feeds input until it ends, chunk_size bytes at a time, and finishes.
+
+		A character split between two reads waits for the next one. Completed tokens are
+		moved to the end of finished and flush is called after every read and once more
+		after finish(), it is expected to empty finished and may return false to stop.
+		Returns false if flush did or reading failed.
+	**/
+	bool feed_stream(
+		std::istream& input,
+		size_t chunk_size,
+		std::pmr::vector<Token>& finished,
+		const std::function<bool()>& flush
+	);
+
+	/**
+		\brief Tokenizes input until it ends or the budget is spent.
+
+		Returns the number of bytes consumed, which always ends on a character boundary
+		and may pass a byte budget by the rest of the last character. Call it again with
+		the unconsumed rest of the input to continue exactly where it stopped and call
+		finish() once the whole input is consumed. A time budget is checked every
+		thousand characters or so.
+	**/
+	size_t tokenize_some(std::string_view input, size_t byte_budget);
+	size_t tokenize_some(std::string_view input, std::chrono::steady_clock::duration time_budget);
+
+	/**
+		\brief Moves every completed token to the end of out.
+
+		A token which is still being built stays in the tokenizer.
+	**/
+	void take_finished(std::pmr::vector<Token>& out);
+
+	static constexpr size_t npos = size_t(-1);
+
+	/**
+		\brief Enables pairing of brackets while tokenizing.
+
+		Brackets are addressed by the index of their token counted from the last reset(),
+		tokens already handed out by take_finished() included.
+	**/
+	void track_brackets(bool enable)	{ m_track_brackets = enable; }
+
+	// index of the bracket paired with the one at index or npos
+	size_t matching_bracket(size_t index) const
+	{
+		return index < m_bracket_partner.size() ? m_bracket_partner[index] : npos;
 	}
-	const std::vector<Token>& tokenize(const std::string& str);
+	// sorted indices of brackets without a pair, complete after finish()
+	const std::pmr::vector<size_t>&	bracket_errors()	const
+	{
+		return m_bracket_errors;
+	}
+
+	/**
+		\brief Feeds every completed token to fingerprinter, nullptr stops it.
+
+		Tokens are fed as they are completed, whether or not they are taken with
+		take_finished(). finish() finishes the fingerprinter and reset() resets it.
+	**/
+	void fingerprint(Fingerprinter* fingerprinter)	{ m_fingerprinter = fingerprinter; }
+
+	// the rules deciding where tokens end, for code writing tokens back as text
+	bool is_delimiter(char c)		const	{ return m_delimiters.count(c) != 0; }
+	bool is_operator_start(char c)	const	{ return m_pot_op.count(c) != 0; }
 
 private:
 	std::set<char>				m_pot_op;		// potential operator start
-	std::set<std::string>		m_actual_ops;		// actual operators
+	std::set<std::string, std::less<>> m_actual_ops;	// actual operators
 	std::set<char>				m_forbidden;		// forbidden for use characters
 	std::set<char>				m_delimiters;		// delimiters char
 	std::set<char>				m_brackets;			// brackets and parenthesis
-	std::set<char>				m_escape_sequence;	// escape sequence
 
-	std::vector<Token>			m_tokens;			//
+	std::pmr::vector<Token>		m_tokens;			//
 	size_t						m_cur_line	= 1,
 								m_cur_col	= 0;
 
 	State						m_state = State::new_token;
 
+	size_t						m_token_offset = 0;		// tokens handed out by take_finished
+
+	bool						m_track_brackets = false;
+	std::pmr::vector<std::pair<size_t, char>> m_bracket_stack;	// open brackets waiting for a pair
+	size_t						m_open_brackets[3] = {};	// of m_bracket_stack by kind: ( { [
+	std::pmr::vector<size_t>	m_bracket_partner;	// token index -> paired token index
+	std::pmr::vector<size_t>	m_bracket_errors;
+
+	Fingerprinter*				m_fingerprinter	= nullptr;
+	size_t						m_fingerprinted	= 0;	// tokens fed to m_fingerprinter, counted like m_token_offset
+
 	Token& last_token() { return m_tokens.back(); }
 
+	void pair_bracket(char bracket);
+
+	size_t consume(
+		std::string_view str,
+		size_t max_bytes,
+		const std::chrono::steady_clock::time_point* deadline
+	);
+
 	void state_change(State new_state);
-	void push_token(const Token& token)		{ m_tokens.push_back(token); }
+	// feeds the first count tokens of m_tokens to m_fingerprinter
+	void fingerprint_finished(size_t count);
+
+	void push_token(const Token& token)
+	{
+		// the token before the new one is complete
+		if (m_fingerprinter)
+			fingerprint_finished(m_tokens.size());
+		m_tokens.push_back(token);
+	}
 };
 
 #endif // !TOKENIZER_HPP
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+/**
+	\brief LatencyHistogram class counts durations in log-linear buckets.
+
+	Every power of two is split into 16 buckets, so a percentile is off by at most
+	~6% of its value while the whole range of 64-bit nanoseconds fits in a fixed table.
+**/
+class LatencyHistogram
+{
+public:
+	void record(uint64_t nanoseconds);
+	void merge(const LatencyHistogram& other);
+
+	uint64_t count()	const { return m_count; }
+	uint64_t max()		const { return m_max; }
+
+	// upper bound of the bucket holding the given fraction (0.5, 0.99, ...) of the durations
+	uint64_t percentile(double fraction) const;
+
+private:
+	static constexpr int	sub_bits	= 4;
+	static constexpr size_t	buckets		= (64 - sub_bits + 1) << sub_bits;
+
+	std::array<uint64_t, buckets>	m_counts{};
+	uint64_t						m_count	= 0,
+									m_max	= 0;
+
+	static size_t	bucket_of(uint64_t value);
+	static uint64_t	bucket_top(size_t bucket);
+};
+
+/**
+	\brief Tracer class collects timed spans of every thread.
+
+	Each thread writes to its own ring buffer, the oldest spans are overwritten once
+	it's full, while the per-name histograms see every span. Disabled tracing costs
+	one relaxed load per span. Dump the results only when no spans are being recorded.
+**/
+class Tracer
+{
+public:
+	struct Event
+	{
+		const char*	m_name	= nullptr;		// has to outlive the tracer, a literal usually
+		uint64_t	m_begin	= 0,			// nanoseconds since the tracer was created
+					m_duration = 0;
+	};
+
+	static Tracer& instance();
+
+	void enable(bool enabled)	{ m_enabled.store(enabled, std::memory_order_relaxed); }
+	bool enabled() const		{ return m_enabled.load(std::memory_order_relaxed); }
+
+	void record(
+		const char* name,
+		std::chrono::steady_clock::time_point begin,
+		std::chrono::steady_clock::time_point end
+	);
+
+	// Chrome trace_event JSON, loadable by chrome://tracing and Perfetto
+	void write_chrome_trace(std::ostream& out) const;
+
+	// p50/p99/p999 and max of every span name
+	void write_summary(std::ostream& out) const;
+
+	std::vector<std::pair<const char*, LatencyHistogram>> histograms() const;
+
+private:
+	static constexpr size_t ring_size = 1 << 16;
+
+	struct ThreadBuffer
+	{
+		size_t				m_thread = 0;
+		std::vector<Event>	m_events;
+		size_t				m_written = 0;		// events ever written, the ring holds the last ring_size
+
+		std::vector<std::pair<const char*, LatencyHistogram>> m_histograms;
+	};
+
+	Tracer();
+
+	std::atomic<bool>							m_enabled{ false };
+	std::chrono::steady_clock::time_point		m_start;
+
+	mutable std::mutex							m_mutex;
+	std::vector<std::shared_ptr<ThreadBuffer>>	m_threads;
+
+	ThreadBuffer& local_buffer();
+};
+
+/**
+	\brief TraceScope class records a span from its construction to its destruction.
+**/
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name)
+		: m_name(Tracer::instance().enabled() ? name : nullptr)
+	{
+		if (m_name)
+			m_begin = std::chrono::steady_clock::now();
+	}
+	~TraceScope()
+	{
+		if (m_name)
+			Tracer::instance().record(m_name, m_begin, std::chrono::steady_clock::now());
+	}
+
+	TraceScope(const TraceScope&)				= delete;
+	TraceScope& operator=(const TraceScope&)	= delete;
+
+private:
+	const char*								m_name;
+	std::chrono::steady_clock::time_point	m_begin;
+};
+
+#endif // !TRACE_HPP
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef UTF8_HPP
+#define UTF8_HPP
+
+#include <cstddef>
+#include <string_view>
+
+/**
+	\brief Helpers for UTF-8 encoded input.
+**/
+namespace utf8
+{
+	// returned by decode() for bytes which don't form a valid sequence
+	constexpr char32_t invalid = 0x110000;
+
+	/**
+		\brief Returns the offset of the first byte which doesn't start a valid
+		UTF-8 sequence or size if the whole input is valid.
+
+		Only runs of ASCII are vectorized: they are skipped 16 bytes at a time with SSE2
+		where available, every multibyte sequence is checked by scalar code.
+	**/
+	size_t validate(const char* data, size_t size);
+
+	// length of the sequence started by lead, 1 for ASCII and stray bytes
+	inline size_t sequence_length(unsigned char lead)
+	{
+		if (lead < 0xC0) return 1;
+		if (lead < 0xE0) return 2;
+		if (lead < 0xF0) return 3;
+		return 4;
+	}
+
+	// decodes a sequence of sequence_length() bytes which validate() accepted
+	char32_t decode(const char* data, size_t length);
+
+	inline bool is_continuation(unsigned char byte) { return (byte & 0xC0) == 0x80; }
+
+	// moves pos back to the start of the character it points into
+	inline size_t floor_boundary(std::string_view str, size_t pos)
+	{
+		for (int i = 0; i < 3 && pos > 0 && pos < str.size() && is_continuation(str[pos]); ++i)
+			--pos;
+		return pos;
+	}
+
+	/**
+		\brief Classification of non-ASCII characters allowed in identifiers.
+
+		Follows the Unicode XID_Start and XID_Continue properties (Unicode 14.0),
+		so symbols and punctuation are rejected and combining marks may continue
+		but not start an identifier.
+	**/
+	bool is_identifier_start(char32_t code_point);
+	bool is_identifier_continue(char32_t code_point);
+}
+
+#endif // !UTF8_HPP
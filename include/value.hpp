@@ -0,0 +1,123 @@
+#pragma once
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <ostream>
+#include <string_view>
+
+/**
+	\brief Value class is a dynamically typed value packed into 64 bits.
+
+	Doubles are stored as they are. Every other type lives in the payload of a
+	negative quiet NaN, which arithmetic never produces because NaN results are
+	stored as the positive quiet NaN:
+
+		1 11111111111 1 ttt pppp...p	t - Type, p - 48 bits of payload
+
+	Integers of up to 48 bits and strings of up to 5 bytes are stored inline. Longer
+	ones are allocated from a memory resource, usually a Region, and never freed one
+	by one. Copying a Value copies a pointer, copy_to() moves its storage elsewhere.
+**/
+class Value
+{
+public:
+	enum class Type : uint8_t
+	{
+		floating,
+		nil,
+		boolean,
+		integer,
+		string,
+	};
+
+	static constexpr size_t max_inline_string = 5;
+
+	Value() : m_bits(box(tag_nil, 0)) {}
+
+	static Value nil()					{ return Value(); }
+	static Value boolean(bool value)	{ return Value(box(tag_boolean, value)); }
+	static Value floating(double value);
+	static Value integer(int64_t value, std::pmr::memory_resource* resource);
+	static Value string(std::string_view value, std::pmr::memory_resource* resource);
+	// left followed by right, allocated once
+	static Value concatenate(std::string_view left, std::string_view right, std::pmr::memory_resource* resource);
+
+	Type type() const;
+
+	bool is_nil()		const { return m_bits == box(tag_nil, 0); }
+	bool is_boolean()	const { return tag() == tag_boolean; }
+	bool is_floating()	const { return (m_bits & box_mask) != box_mask; }
+	bool is_integer()	const { return tag() == tag_integer || tag() == tag_big_integer; }
+	bool is_string()	const { return tag() == tag_string || tag() == tag_big_string; }
+
+	bool as_boolean()	const { return m_bits & 1; }
+	double as_floating() const
+	{
+		double value;
+		std::memcpy(&value, &m_bits, sizeof(value));
+		return value;
+	}
+	int64_t as_integer() const
+	{
+		if (tag() == tag_integer)
+			return int64_t(m_bits << 16) >> 16;
+		return *static_cast<const int64_t*>(pointer());
+	}
+	// valid as long as this Value and the storage of the string are
+	std::string_view as_string() const;
+
+	// numbers as a double, meaningful for integers and floatings only
+	double as_number() const { return is_floating() ? as_floating() : double(as_integer()); }
+
+	// nil, false, zeroes and the empty string are false
+	bool truthy() const;
+
+	// same value, with the out of line storage copied to resource
+	Value copy_to(std::pmr::memory_resource* resource) const;
+
+	// out of line bytes held by the value
+	size_t heap_size() const;
+
+	uint64_t bits() const { return m_bits; }
+
+private:
+	static constexpr uint64_t box_mask		= 0xFFF8'0000'0000'0000;
+	static constexpr uint64_t payload_mask	= 0x0000'FFFF'FFFF'FFFF;
+
+	static constexpr uint64_t tag_nil			= 1;
+	static constexpr uint64_t tag_boolean		= 2;
+	static constexpr uint64_t tag_integer		= 3;
+	static constexpr uint64_t tag_big_integer	= 4;
+	static constexpr uint64_t tag_string		= 5;
+	static constexpr uint64_t tag_big_string	= 6;
+
+	struct StringObject
+	{
+		size_t	m_size;
+		char	m_data[1];
+	};
+
+	uint64_t m_bits;
+
+	explicit Value(uint64_t bits) : m_bits(bits) {}
+
+	static StringObject* new_string(size_t size, std::pmr::memory_resource* resource);
+
+	static constexpr uint64_t box(uint64_t tag, uint64_t payload)
+	{
+		return box_mask | tag << 48 | (payload & payload_mask);
+	}
+
+	uint64_t tag() const { return (m_bits & box_mask) == box_mask ? (m_bits >> 48) & 7 : 0; }
+	const void* pointer() const { return reinterpret_cast<const void*>(uintptr_t(m_bits & payload_mask)); }
+};
+
+static_assert(sizeof(Value) == 8);
+
+// floatings in their shortest round-trip form, strings without quotes
+std::ostream& operator<<(std::ostream& out, const Value& value);
+
+#endif // !VALUE_HPP
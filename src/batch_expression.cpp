@@ -0,0 +1,540 @@
+#include "batch_expression.hpp"
+#include "evaluator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	using Op	= Expression::Op;
+	using Type	= BatchExpression::Type;
+
+	/*
+		Kernels run one operator over a block. Operators set bad instead of branching
+		out of the loop, so the loops stay simple enough to be vectorized.
+	*/
+	template<typename A, typename B, typename R, typename F>
+	bool binary(const void* a, const void* b, void* out, size_t rows)
+	{
+		auto x = static_cast<const A*>(a);
+		auto y = static_cast<const B*>(b);
+		auto r = static_cast<R*>(out);
+
+		uint64_t bad = 0;
+		for (size_t i = 0; i < rows; ++i)
+			r[i] = F::apply(x[i], y[i], bad);
+		return bad == 0;
+	}
+
+	template<typename A, typename R, typename F>
+	bool unary(const void* a, const void*, void* out, size_t rows)
+	{
+		auto x = static_cast<const A*>(a);
+		auto r = static_cast<R*>(out);
+
+		uint64_t bad = 0;
+		for (size_t i = 0; i < rows; ++i)
+			r[i] = F::apply(x[i], bad);
+		return bad == 0;
+	}
+
+	struct Add
+	{
+		static double apply(double a, double b, uint64_t&) { return a + b; }
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			auto r = int64_t(uint64_t(a) + uint64_t(b));
+			bad |= uint64_t((a ^ r) & (b ^ r)) >> 63;
+			return r;
+		}
+	};
+	struct Subtract
+	{
+		static double apply(double a, double b, uint64_t&) { return a - b; }
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			auto r = int64_t(uint64_t(a) - uint64_t(b));
+			bad |= uint64_t((a ^ b) & (a ^ r)) >> 63;
+			return r;
+		}
+	};
+	struct Multiply
+	{
+		static double apply(double a, double b, uint64_t&) { return a * b; }
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			int64_t r;
+			bad |= __builtin_mul_overflow(a, b, &r);
+			return r;
+		}
+	};
+	struct Divide
+	{
+		static double apply(double a, double b, uint64_t& bad)
+		{
+			bad |= b == 0;
+			return a / b;
+		}
+	};
+	struct FloorDivide
+	{
+		static double apply(double a, double b, uint64_t& bad)
+		{
+			bad |= b == 0;
+			return std::floor(a / b);
+		}
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			bool fails = b == 0 || (a == INT64_MIN && b == -1);
+			bad |= fails;
+			return floor_divide(a, fails ? 1 : b);
+		}
+	};
+	struct Modulo
+	{
+		static double apply(double a, double b, uint64_t& bad)
+		{
+			bad |= b == 0;
+			return a - std::floor(a / b) * b;
+		}
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			bool fails = b == 0 || (a == INT64_MIN && b == -1);
+			bad |= fails;
+			b = fails ? 1 : b;
+			return a - floor_divide(a, b) * b;
+		}
+	};
+	struct Power
+	{
+		static double apply(double a, double b, uint64_t&) { return std::pow(a, b); }
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			int64_t r = 0;
+			bad |= b < 0 || !integer_power(a, b, r);
+			return r;
+		}
+	};
+
+	template<typename Compare>
+	struct Comparison
+	{
+		template<typename T>
+		static uint8_t apply(T a, T b, uint64_t&) { return Compare()(a, b); }
+	};
+
+	struct BitAnd		{ static int64_t apply(int64_t a, int64_t b, uint64_t&) { return a & b; } };
+	struct BitOr		{ static int64_t apply(int64_t a, int64_t b, uint64_t&) { return a | b; } };
+	struct BitXor		{ static int64_t apply(int64_t a, int64_t b, uint64_t&) { return a ^ b; } };
+	struct LogicalAnd	{ static uint8_t apply(uint8_t a, uint8_t b, uint64_t&) { return a & b; } };
+	struct LogicalOr	{ static uint8_t apply(uint8_t a, uint8_t b, uint64_t&) { return a | b; } };
+
+	struct ShiftLeft
+	{
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			bad |= uint64_t(b) > 63;
+			return int64_t(uint64_t(a) << (b & 63));
+		}
+	};
+	struct ShiftRight
+	{
+		static int64_t apply(int64_t a, int64_t b, uint64_t& bad)
+		{
+			bad |= uint64_t(b) > 63;
+			return a >> (b & 63);
+		}
+	};
+
+	struct Negate
+	{
+		static double apply(double a, uint64_t&) { return -a; }
+		static int64_t apply(int64_t a, uint64_t& bad)
+		{
+			bad |= a == INT64_MIN;
+			return int64_t(0 - uint64_t(a));
+		}
+	};
+	struct BitNot		{ static int64_t apply(int64_t a, uint64_t&) { return ~a; } };
+	struct ToFloating	{ static double apply(int64_t a, uint64_t&) { return double(a); } };
+
+	struct Truthy
+	{
+		template<typename T>
+		static uint8_t apply(T a, uint64_t&) { return a != 0; }
+	};
+	struct Falsy
+	{
+		template<typename T>
+		static uint8_t apply(T a, uint64_t&) { return a == 0; }
+	};
+
+	size_t type_size(Type type) { return type == Type::boolean ? 1 : 8; }
+
+	template<typename F>
+	BatchExpression::Kernel unary_for(Type type)
+	{
+		switch (type)
+		{
+		case Type::integer:		return unary<int64_t, uint8_t, F>;
+		case Type::floating:	return unary<double, uint8_t, F>;
+		default:				return unary<uint8_t, uint8_t, F>;
+		}
+	}
+
+	template<typename Compare>
+	BatchExpression::Kernel comparison_for(Type type)
+	{
+		switch (type)
+		{
+		case Type::integer:		return binary<int64_t, int64_t, uint8_t, Comparison<Compare>>;
+		case Type::floating:	return binary<double, double, uint8_t, Comparison<Compare>>;
+		default:				return binary<uint8_t, uint8_t, uint8_t, Comparison<Compare>>;
+		}
+	}
+
+	template<typename F>
+	BatchExpression::Kernel arithmetic_for(Type type)
+	{
+		return type == Type::integer ? binary<int64_t, int64_t, int64_t, F> : binary<double, double, double, F>;
+	}
+}
+
+size_t BatchExpression::add_register(Type type)
+{
+	m_registers.push_back({ type });
+	return m_registers.size() - 1;
+}
+
+void BatchExpression::add_step(Kernel kernel, size_t a, size_t b, size_t out, const char* error)
+{
+	m_steps.push_back({ kernel, a, b, out, error });
+}
+
+size_t BatchExpression::to_floating(size_t reg)
+{
+	if (m_registers[reg].m_type != Type::integer)
+		return reg;
+
+	auto converted = add_register(Type::floating);
+	add_step(unary<int64_t, double, ToFloating>, reg, reg, converted, nullptr);
+	return converted;
+}
+
+bool BatchExpression::compile(
+	const Expression& expression,
+	const std::vector<std::pair<std::string, Type>>& columns,
+	std::string& error
+)
+{
+	m_registers.clear();
+	m_steps.clear();
+
+	auto& code = expression.code();
+	if (code.empty())
+	{
+		error = "empty expression";
+		return false;
+	}
+
+	std::vector<size_t> names(expression.names().size(), size_t(-1));	// name -> register
+	std::vector<size_t> stack;
+	std::vector<std::pair<uint32_t, Op>> pending;	// && and || waiting for their right operand
+
+	auto mismatch = [&](Op op)
+	{
+		error = std::string("unsupported operand for ") + Expression::symbol(op);
+		return false;
+	};
+
+	for (size_t pc = 0; pc <= code.size(); ++pc)
+	{
+		// jumps nested inside of the right operand of another one end first
+		while (!pending.empty() && pending.back().first == pc)
+		{
+			auto b = stack.back();
+			stack.pop_back();
+			auto a = stack.back();
+
+			auto out = add_register(Type::boolean);
+			add_step(
+				pending.back().second == Op::jump_if_false
+					? binary<uint8_t, uint8_t, uint8_t, LogicalAnd>
+					: binary<uint8_t, uint8_t, uint8_t, LogicalOr>,
+				a, b, out, nullptr
+			);
+			stack.back() = out;
+			pending.pop_back();
+		}
+		if (pc == code.size())
+			break;
+
+		auto& instruction = code[pc];
+		auto op = instruction.m_op;
+
+		switch (op)
+		{
+		case Op::constant:
+		{
+			auto value = expression.constants()[instruction.m_operand];
+			Type type;
+			if (value.is_integer())
+				type = Type::integer;
+			else if (value.is_floating())
+				type = Type::floating;
+			else if (value.is_boolean())
+				type = Type::boolean;
+			else
+			{
+				error = "only numbers and booleans can be evaluated over columns";
+				return false;
+			}
+
+			stack.push_back(add_register(type));
+
+			// big integers point into the memory of the expression, which may go away
+			auto& reg = m_registers.back();
+			reg.m_constant = true;
+			if (type == Type::integer)
+				reg.m_bits = uint64_t(value.as_integer());
+			else if (type == Type::floating)
+				reg.m_bits = value.bits();
+			else
+				reg.m_bits = value.as_boolean();
+			break;
+		}
+
+		case Op::variable:
+		{
+			auto& reg = names[instruction.m_operand];
+			if (reg == size_t(-1))
+			{
+				auto& name = expression.names()[instruction.m_operand];
+				auto column = std::find_if(columns.begin(), columns.end(),
+					[&](const std::pair<std::string, Type>& el) { return el.first == name; });
+
+				if (column == columns.end())
+				{
+					error = "unknown variable " + name;
+					return false;
+				}
+
+				reg = add_register(column->second);
+				m_registers[reg].m_column = int(column - columns.begin());
+			}
+			stack.push_back(reg);
+			break;
+		}
+
+		case Op::jump_if_false:
+		case Op::jump_if_true:
+		case Op::to_boolean:
+		{
+			auto reg = stack.back();
+			if (m_registers[reg].m_type != Type::boolean)
+			{
+				stack.back() = add_register(Type::boolean);
+				add_step(unary_for<Truthy>(m_registers[reg].m_type), reg, reg, stack.back(), nullptr);
+			}
+			if (op != Op::to_boolean)
+				pending.emplace_back(instruction.m_operand, op);
+			break;
+		}
+
+		case Op::logical_not:
+		{
+			auto reg = stack.back();
+			stack.back() = add_register(Type::boolean);
+			add_step(unary_for<Falsy>(m_registers[reg].m_type), reg, reg, stack.back(), nullptr);
+			break;
+		}
+
+		case Op::negate:
+		case Op::bit_not:
+		{
+			auto reg = stack.back();
+			auto type = m_registers[reg].m_type;
+
+			if (type == Type::boolean || (op == Op::bit_not && type != Type::integer))
+				return mismatch(op);
+
+			stack.back() = add_register(type);
+			if (op == Op::bit_not)
+				add_step(unary<int64_t, int64_t, BitNot>, reg, reg, stack.back(), nullptr);
+			else if (type == Type::integer)
+				add_step(unary<int64_t, int64_t, Negate>, reg, reg, stack.back(), "integer overflow");
+			else
+				add_step(unary<double, double, Negate>, reg, reg, stack.back(), nullptr);
+			break;
+		}
+
+		default:
+		{
+			auto b = stack.back();
+			stack.pop_back();
+			auto a = stack.back();
+
+			auto a_type = m_registers[a].m_type;
+			auto b_type = m_registers[b].m_type;
+			bool integers = a_type == Type::integer && b_type == Type::integer;
+			bool numbers = a_type != Type::boolean && b_type != Type::boolean;
+
+			Kernel kernel;
+			Type type = integers ? Type::integer : Type::floating;
+			const char* fails = nullptr;
+
+			switch (op)
+			{
+			case Op::add:
+			case Op::subtract:
+			case Op::multiply:
+				if (!numbers)
+					return mismatch(op);
+				kernel =	op == Op::add		? arithmetic_for<Add>(type) :
+							op == Op::subtract	? arithmetic_for<Subtract>(type) :
+												  arithmetic_for<Multiply>(type);
+				fails = integers ? "integer overflow" : nullptr;
+				break;
+
+			case Op::divide:
+				if (!numbers)
+					return mismatch(op);
+				type = Type::floating;
+				kernel = binary<double, double, double, Divide>;
+				fails = "division by zero";
+				break;
+
+			case Op::floor_divide:
+			case Op::modulo:
+				if (!numbers)
+					return mismatch(op);
+				kernel = op == Op::floor_divide ? arithmetic_for<FloorDivide>(type) : arithmetic_for<Modulo>(type);
+				fails = integers ? "division by zero or overflow" : "division by zero";
+				break;
+
+			case Op::power:
+				if (!numbers)
+					return mismatch(op);
+				kernel = arithmetic_for<Power>(type);
+				fails = integers ? "integer overflow or negative exponent" : nullptr;
+				break;
+
+			case Op::equal:
+			case Op::not_equal:
+			case Op::less:
+			case Op::less_equal:
+			case Op::greater:
+			case Op::greater_equal:
+			{
+				bool booleans = a_type == Type::boolean && b_type == Type::boolean;
+				if (!numbers && !(booleans && (op == Op::equal || op == Op::not_equal)))
+					return mismatch(op);
+
+				auto compared = booleans ? Type::boolean : type;
+				kernel =	op == Op::equal			? comparison_for<std::equal_to<>>(compared) :
+							op == Op::not_equal		? comparison_for<std::not_equal_to<>>(compared) :
+							op == Op::less			? comparison_for<std::less<>>(compared) :
+							op == Op::less_equal	? comparison_for<std::less_equal<>>(compared) :
+							op == Op::greater		? comparison_for<std::greater<>>(compared) :
+													  comparison_for<std::greater_equal<>>(compared);
+				type = Type::boolean;
+				break;
+			}
+
+			case Op::bit_and:
+			case Op::bit_or:
+			case Op::bit_xor:
+			case Op::shift_left:
+			case Op::shift_right:
+				if (!integers)
+					return mismatch(op);
+				kernel =	op == Op::bit_and		? binary<int64_t, int64_t, int64_t, BitAnd> :
+							op == Op::bit_or		? binary<int64_t, int64_t, int64_t, BitOr> :
+							op == Op::bit_xor		? binary<int64_t, int64_t, int64_t, BitXor> :
+							op == Op::shift_left	? binary<int64_t, int64_t, int64_t, ShiftLeft> :
+													  binary<int64_t, int64_t, int64_t, ShiftRight>;
+				fails = op == Op::shift_left || op == Op::shift_right ? "shift count out of range" : nullptr;
+				break;
+
+			default:
+				return mismatch(op);
+			}
+
+			// mixed operands are computed as floatings
+			if (a_type != b_type && numbers)
+			{
+				a = to_floating(a);
+				b = to_floating(b);
+			}
+			if (op == Op::divide)
+			{
+				a = to_floating(a);
+				b = to_floating(b);
+			}
+
+			stack.back() = add_register(type);
+			add_step(kernel, a, b, stack.back(), fails);
+			break;
+		}
+		}
+	}
+
+	m_result		= stack.back();
+	m_result_type	= m_registers[m_result].m_type;
+
+	return true;
+}
+
+bool BatchExpression::run(const std::vector<const void*>& columns, size_t rows, void* out, std::string& error)
+{
+	m_buffers.resize(m_registers.size() * block_rows);
+
+	for (size_t i = 0; i < m_registers.size(); ++i)
+	{
+		auto& reg = m_registers[i];
+		auto buffer = m_buffers.data() + i * block_rows;
+
+		// constants are spread over a block once, the kernels see them as columns
+		if (reg.m_constant)
+		{
+			if (reg.m_type == Type::boolean)
+				std::fill_n(reinterpret_cast<uint8_t*>(buffer), block_rows, uint8_t(reg.m_bits));
+			else
+				std::fill_n(buffer, block_rows, reg.m_bits);
+		}
+		reg.m_data = buffer;
+	}
+
+	auto& result = m_registers[m_result];
+	auto result_size = type_size(m_result_type);
+	bool computed = result.m_column < 0 && !result.m_constant;
+
+	for (size_t start = 0; start < rows; start += block_rows)
+	{
+		auto count = std::min(block_rows, rows - start);
+
+		for (auto& reg : m_registers)
+			if (reg.m_column >= 0)
+				reg.m_data = const_cast<char*>(static_cast<const char*>(columns[size_t(reg.m_column)])) + start * type_size(reg.m_type);
+
+		// the last step writes straight into out
+		auto target = static_cast<char*>(out) + start * result_size;
+		if (computed)
+			result.m_data = target;
+
+		for (auto& step : m_steps)
+		{
+			if (!step.m_kernel(m_registers[step.m_a].m_data, m_registers[step.m_b].m_data, m_registers[step.m_out].m_data, count))
+			{
+				error = step.m_error;
+				return false;
+			}
+		}
+
+		if (!computed)
+			std::memcpy(target, result.m_data, count * result_size);
+	}
+
+	return true;
+}
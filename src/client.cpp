@@ -0,0 +1,116 @@
+#include "client.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+Client::~Client()
+{
+	close();
+}
+
+bool Client::connect(const std::string& socket_path)
+{
+	close();
+
+	sockaddr_un address{};
+	if (socket_path.size() >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+	m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_fd < 0)
+		return false;
+
+	if (::connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void Client::close()
+{
+	if (m_fd >= 0)
+		::close(m_fd);
+	m_fd = -1;
+}
+
+bool Client::call(const std::vector<protocol::Request>& requests, std::vector<protocol::Response>& responses)
+{
+	m_output.clear();
+	for (auto& request : requests)
+		protocol::write_request(m_output, request);
+
+	responses.resize(requests.size());
+	m_input.clear();
+
+	// responses are read while requests are still being sent, the server stops reading
+	// once it can't write, and a batch larger than both socket buffers would deadlock
+	size_t sent = 0;
+	size_t used = 0;
+	for (size_t i = 0; i < requests.size();)
+	{
+		bool malformed;
+		auto size = protocol::read_response(std::string_view(m_input).substr(used), requests[i].m_op, responses[i], malformed);
+
+		if (size == protocol::broken_stream || (size && malformed))
+			return false;
+		if (size)
+		{
+			used += size;
+			++i;
+			continue;
+		}
+
+		pollfd fd = { m_fd, short(POLLIN | (sent < m_output.size() ? POLLOUT : 0)), 0 };
+		if (::poll(&fd, 1, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		if (fd.revents & POLLOUT)
+		{
+			auto count = ::send(m_fd, m_output.data() + sent, m_output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (count < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+				return false;
+			if (count > 0)
+				sent += size_t(count);
+		}
+
+		if (fd.revents & (POLLIN | POLLHUP | POLLERR))
+		{
+			// responses own copies of their tokens, the buffer can start over
+			if (used == m_input.size())
+			{
+				m_input.clear();
+				used = 0;
+			}
+
+			auto old_size = m_input.size();
+			m_input.resize(old_size + 64 * 1024);
+
+			auto count = ::recv(m_fd, m_input.data() + old_size, 64 * 1024, MSG_DONTWAIT);
+			m_input.resize(old_size + size_t(std::max<ssize_t>(count, 0)));
+
+			if (count == 0)
+				return false;
+			if (count < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+				return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,21 @@
+#include "command_line.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+bool command_line::parse_count(const char* text, size_t& value)
+{
+	// strtoul would take leading whitespace and a minus sign
+	if (!std::isdigit(static_cast<unsigned char>(*text)))
+		return false;
+
+	errno = 0;
+	char* end = nullptr;
+	auto parsed = std::strtoul(text, &end, 10);
+	if (errno != 0 || *end != 0)
+		return false;
+
+	value = parsed;
+	return true;
+}
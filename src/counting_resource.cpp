@@ -0,0 +1,49 @@
+#include "counting_resource.hpp"
+
+CountingResource::Stats CountingResource::stats() const
+{
+	Stats stats;
+	stats.m_allocations		= m_allocations.load(std::memory_order_relaxed);
+	stats.m_deallocations	= m_deallocations.load(std::memory_order_relaxed);
+	stats.m_bytes			= m_bytes.load(std::memory_order_relaxed);
+	stats.m_bytes_in_use	= m_bytes_in_use.load(std::memory_order_relaxed);
+	stats.m_peak_bytes		= m_peak_bytes.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+void CountingResource::reset_stats()
+{
+	m_allocations.store(0, std::memory_order_relaxed);
+	m_deallocations.store(0, std::memory_order_relaxed);
+	m_bytes.store(0, std::memory_order_relaxed);
+	m_peak_bytes.store(m_bytes_in_use.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void* CountingResource::do_allocate(size_t bytes, size_t alignment)
+{
+	auto p = m_upstream->allocate(bytes, alignment);
+
+	m_allocations.fetch_add(1, std::memory_order_relaxed);
+	m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+	auto in_use = m_bytes_in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	auto peak = m_peak_bytes.load(std::memory_order_relaxed);
+	while (in_use > peak && !m_peak_bytes.compare_exchange_weak(peak, in_use, std::memory_order_relaxed))
+		;
+
+	return p;
+}
+
+void CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+	m_upstream->deallocate(p, bytes, alignment);
+
+	m_deallocations.fetch_add(1, std::memory_order_relaxed);
+	m_bytes_in_use.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
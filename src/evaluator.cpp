@@ -0,0 +1,423 @@
+#include "evaluator.hpp"
+#include "trace.hpp"
+
+#include <cmath>
+
+namespace
+{
+	using Op = Expression::Op;
+
+	struct Assignment
+	{
+		std::string_view	m_text;
+		Op					m_op;
+	};
+
+	// "=" is handled on its own, the others apply their operator to the old value
+	const Assignment compound_assignments[] =
+	{
+		{ "+=",		Op::add },
+		{ "-=",		Op::subtract },
+		{ "*=",		Op::multiply },
+		{ "**=",	Op::power },
+		{ "/=",		Op::divide },
+		{ "//=",	Op::floor_divide },
+		{ "%=",		Op::modulo },
+		{ "&=",		Op::bit_and },
+		{ "|=",		Op::bit_or },
+		{ "^=",		Op::bit_xor },
+		{ "<<=",	Op::shift_left },
+		{ ">>=",	Op::shift_right },
+		{ "&&=",	Op::jump_if_false },
+		{ "||=",	Op::jump_if_true },
+	};
+
+	// collecting a session smaller than this isn't worth it
+	constexpr size_t min_garbage = 64 * 1024;
+
+	bool is_number(Value value) { return value.is_integer() || value.is_floating(); }
+}
+
+int64_t floor_divide(int64_t a, int64_t b)
+{
+	auto quotient = a / b;
+	if (a % b != 0 && (a < 0) != (b < 0))
+		--quotient;
+	return quotient;
+}
+
+bool integer_power(int64_t base, int64_t exponent, int64_t& result)
+{
+	result = 1;
+	while (exponent > 0)
+	{
+		if ((exponent & 1) && __builtin_mul_overflow(result, base, &result))
+			return false;
+		exponent >>= 1;
+		if (exponent > 0 && __builtin_mul_overflow(base, base, &base))
+			return false;
+	}
+	return true;
+}
+
+Evaluator::Evaluator(std::pmr::memory_resource* upstream)
+	: m_scratch(64 * 1024, upstream), m_generations{ Region(64 * 1024, upstream), Region(64 * 1024, upstream) }
+{}
+
+bool Evaluator::run(const Token* begin, const Token* end, Value& result, ParseError& error)
+{
+	m_scratch.clear();
+	result = Value();
+
+	if (begin == end)
+		return true;
+
+	// name = expression, name op= expression
+	const Token* target = nullptr;
+	const Assignment* compound = nullptr;
+	{
+		TraceScope span("parse");
+
+		if (	end - begin >= 2
+			&&	begin[0].m_type == Token::Type::identificator
+			&&	begin[1].m_type == Token::Type::_operator)
+		{
+			std::string_view op = begin[1].m_value;
+			for (auto& assignment : compound_assignments)
+				if (assignment.m_text == op)
+					compound = &assignment;
+
+			if (op == "=" || compound)
+				target = begin;
+		}
+
+		auto first = target ? begin + 2 : begin;
+		if (auto failed = m_expression.compile(first, end, &m_scratch))
+		{
+			error = std::move(*failed);
+			error.m_token += size_t(first - begin);
+			return false;
+		}
+	}
+
+	TraceScope span("evaluate");
+
+	// errors past this point aren't about a particular token
+	error = ParseError{ 0, size_t(end - begin), {} };
+	if (!evaluate(m_expression, result, error.m_message))
+		return false;
+
+	if (!target)
+		return true;
+
+	std::string_view name = target->m_value;
+	if (name == "true" || name == "false" || name == "nil")
+	{
+		error.m_message = "can't assign to " + std::string(name);
+		return false;
+	}
+
+	if (compound)
+	{
+		auto old = variable(name);
+		if (!old)
+		{
+			error.m_message = "unknown variable " + std::string(name);
+			return false;
+		}
+
+		if (compound->m_op == Op::jump_if_false)
+			result = Value::boolean(old->truthy() && result.truthy());
+		else if (compound->m_op == Op::jump_if_true)
+			result = Value::boolean(old->truthy() || result.truthy());
+		else if (!apply(compound->m_op, *old, result, &m_scratch, result, error.m_message))
+			return false;
+	}
+
+	assign(name, result);
+	result = *variable(name);
+
+	return true;
+}
+
+bool Evaluator::evaluate(const Expression& expression, Value& result, std::string& error)
+{
+	auto& code = expression.code();
+
+	m_stack.clear();
+	m_stack.reserve(expression.max_depth());
+
+	for (size_t pc = 0; pc < code.size(); ++pc)
+	{
+		auto& instruction = code[pc];
+
+		switch (instruction.m_op)
+		{
+		case Op::constant:
+			m_stack.push_back(expression.constants()[instruction.m_operand]);
+			break;
+
+		case Op::variable:
+		{
+			auto& name = expression.names()[instruction.m_operand];
+			auto value = variable(name);
+			if (!value)
+			{
+				error = "unknown variable " + name;
+				return false;
+			}
+			m_stack.push_back(*value);
+			break;
+		}
+
+		case Op::jump_if_false:
+		case Op::jump_if_true:
+			if (m_stack.back().truthy() == (instruction.m_op == Op::jump_if_true))
+			{
+				m_stack.back() = Value::boolean(instruction.m_op == Op::jump_if_true);
+				pc = instruction.m_operand - 1;
+			}
+			else
+				m_stack.pop_back();
+			break;
+
+		case Op::to_boolean:
+			m_stack.back() = Value::boolean(m_stack.back().truthy());
+			break;
+
+		case Op::negate:
+		case Op::logical_not:
+		case Op::bit_not:
+			if (!apply(instruction.m_op, m_stack.back(), Value(), &m_scratch, m_stack.back(), error))
+				return false;
+			break;
+
+		default:
+		{
+			auto b = m_stack.back();
+			m_stack.pop_back();
+			if (!apply(instruction.m_op, m_stack.back(), b, &m_scratch, m_stack.back(), error))
+				return false;
+			break;
+		}
+		}
+	}
+
+	result = m_stack.empty() ? Value() : m_stack.back();
+	return true;
+}
+
+bool Evaluator::apply(Op op, Value a, Value b, std::pmr::memory_resource* resource, Value& result, std::string& error)
+{
+	auto mismatch = [&]
+	{
+		error = std::string("unsupported operand for ") + Expression::symbol(op);
+		return false;
+	};
+	auto both_integers = a.is_integer() && b.is_integer();
+	auto both_numbers = is_number(a) && is_number(b);
+
+	switch (op)
+	{
+	case Op::negate:
+		if (a.is_integer() && a.as_integer() != INT64_MIN)
+			result = Value::integer(-a.as_integer(), resource);
+		else if (is_number(a))
+			result = Value::floating(-a.as_number());
+		else
+			return mismatch();
+		return true;
+
+	case Op::logical_not:
+		result = Value::boolean(!a.truthy());
+		return true;
+
+	case Op::bit_not:
+		if (!a.is_integer())
+			return mismatch();
+		result = Value::integer(~a.as_integer(), resource);
+		return true;
+
+	case Op::add:
+	case Op::subtract:
+	case Op::multiply:
+	{
+		if (op == Op::add && a.is_string() && b.is_string())
+		{
+			result = Value::concatenate(a.as_string(), b.as_string(), resource);
+			return true;
+		}
+		if (!both_numbers)
+			return mismatch();
+
+		int64_t integer;
+		if (both_integers)
+		{
+			bool overflow =
+				op == Op::add		? __builtin_add_overflow(a.as_integer(), b.as_integer(), &integer) :
+				op == Op::subtract	? __builtin_sub_overflow(a.as_integer(), b.as_integer(), &integer) :
+									  __builtin_mul_overflow(a.as_integer(), b.as_integer(), &integer);
+			if (!overflow)
+			{
+				result = Value::integer(integer, resource);
+				return true;
+			}
+		}
+
+		auto x = a.as_number(), y = b.as_number();
+		result = Value::floating(op == Op::add ? x + y : op == Op::subtract ? x - y : x * y);
+		return true;
+	}
+
+	case Op::divide:
+	case Op::floor_divide:
+	case Op::modulo:
+		if (!both_numbers)
+			return mismatch();
+		if (b.as_number() == 0)
+		{
+			error = "division by zero";
+			return false;
+		}
+
+		if (both_integers && op != Op::divide && !(a.as_integer() == INT64_MIN && b.as_integer() == -1))
+		{
+			auto quotient = floor_divide(a.as_integer(), b.as_integer());
+			result = Value::integer(op == Op::floor_divide ? quotient : a.as_integer() - quotient * b.as_integer(), resource);
+		}
+		else if (op == Op::divide)
+			result = Value::floating(a.as_number() / b.as_number());
+		else
+		{
+			auto quotient = std::floor(a.as_number() / b.as_number());
+			result = Value::floating(op == Op::floor_divide ? quotient : a.as_number() - quotient * b.as_number());
+		}
+		return true;
+
+	case Op::power:
+	{
+		if (!both_numbers)
+			return mismatch();
+
+		int64_t integer;
+		if (both_integers && b.as_integer() >= 0 && integer_power(a.as_integer(), b.as_integer(), integer))
+			result = Value::integer(integer, resource);
+		else
+			result = Value::floating(std::pow(a.as_number(), b.as_number()));
+		return true;
+	}
+
+	case Op::equal:
+	case Op::not_equal:
+	{
+		bool equal;
+		if (both_numbers)
+			equal = both_integers ? a.as_integer() == b.as_integer() : a.as_number() == b.as_number();
+		else if (a.is_string() && b.is_string())
+			equal = a.as_string() == b.as_string();
+		else
+			equal = a.type() == b.type() && a.bits() == b.bits();
+
+		result = Value::boolean(equal == (op == Op::equal));
+		return true;
+	}
+
+	case Op::less:
+	case Op::less_equal:
+	case Op::greater:
+	case Op::greater_equal:
+	{
+		int order;
+		if (both_integers)
+			order = a.as_integer() < b.as_integer() ? -1 : a.as_integer() > b.as_integer();
+		else if (both_numbers)
+		{
+			auto x = a.as_number(), y = b.as_number();
+			// every comparison with NaN is false
+			if (x != x || y != y)
+			{
+				result = Value::boolean(false);
+				return true;
+			}
+			order = x < y ? -1 : x > y;
+		}
+		else if (a.is_string() && b.is_string())
+			order = a.as_string().compare(b.as_string());
+		else
+			return mismatch();
+
+		result = Value::boolean(
+			op == Op::less			? order < 0		:
+			op == Op::less_equal	? order <= 0	:
+			op == Op::greater		? order > 0		:
+									  order >= 0
+		);
+		return true;
+	}
+
+	case Op::bit_and:
+	case Op::bit_or:
+	case Op::bit_xor:
+	case Op::shift_left:
+	case Op::shift_right:
+	{
+		if (!both_integers)
+			return mismatch();
+
+		auto x = a.as_integer(), y = b.as_integer();
+		if ((op == Op::shift_left || op == Op::shift_right) && (y < 0 || y > 63))
+		{
+			error = "shift count out of range";
+			return false;
+		}
+
+		result = Value::integer(
+			op == Op::bit_and		? x & y :
+			op == Op::bit_or		? x | y :
+			op == Op::bit_xor		? x ^ y :
+			op == Op::shift_left	? int64_t(uint64_t(x) << y) :
+									  x >> y,
+			resource
+		);
+		return true;
+	}
+
+	default:
+		return mismatch();
+	}
+}
+
+void Evaluator::assign(std::string_view name, Value value)
+{
+	auto found = m_variables.find(name);
+	if (found == m_variables.end())
+		found = m_variables.emplace(std::string(name), Value()).first;
+
+	m_garbage_bytes += found->second.heap_size();
+	m_live_bytes -= found->second.heap_size();
+
+	found->second = value.copy_to(&m_generations[m_generation]);
+	m_live_bytes += found->second.heap_size();
+
+	if (m_garbage_bytes > min_garbage && m_garbage_bytes > m_live_bytes)
+		collect();
+}
+
+const Value* Evaluator::variable(std::string_view name) const
+{
+	auto found = m_variables.find(name);
+	return found == m_variables.end() ? nullptr : &found->second;
+}
+
+void Evaluator::collect()
+{
+	auto& next = m_generations[1 - m_generation];
+	next.clear();
+
+	for (auto& [name, value] : m_variables)
+		value = value.copy_to(&next);
+
+	m_generations[m_generation].clear();
+	m_generation = 1 - m_generation;
+	m_garbage_bytes = 0;
+}
@@ -0,0 +1,322 @@
+#include "expression.hpp"
+#include "string_literal.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace
+{
+	struct Infix
+	{
+		std::string_view	m_text;
+		Expression::Op		m_op;
+		int					m_power;
+	};
+
+	constexpr int unary_power		= 11;
+	constexpr int subtract_power	= 9;
+
+	const Infix infix_operators[] =
+	{
+		{ "||",	Expression::Op::jump_if_true,	1 },
+		{ "&&",	Expression::Op::jump_if_false,	2 },
+		{ "|",	Expression::Op::bit_or,			3 },
+		{ "^",	Expression::Op::bit_xor,		4 },
+		{ "&",	Expression::Op::bit_and,		5 },
+		{ "==",	Expression::Op::equal,			6 },
+		{ "!=",	Expression::Op::not_equal,		6 },
+		{ "<",	Expression::Op::less,			7 },
+		{ "<=",	Expression::Op::less_equal,		7 },
+		{ ">",	Expression::Op::greater,		7 },
+		{ ">=",	Expression::Op::greater_equal,	7 },
+		{ "<<",	Expression::Op::shift_left,		8 },
+		{ ">>",	Expression::Op::shift_right,	8 },
+		{ "+",	Expression::Op::add,			9 },
+		{ "-",	Expression::Op::subtract,		subtract_power },
+		{ "*",	Expression::Op::multiply,		10 },
+		{ "/",	Expression::Op::divide,			10 },
+		{ "//",	Expression::Op::floor_divide,	10 },
+		{ "%",	Expression::Op::modulo,			10 },
+		{ "**",	Expression::Op::power,			12 },
+	};
+
+	bool is_number(const Token& token)
+	{
+		return token.m_type == Token::Type::integer || token.m_type == Token::Type::floating;
+	}
+}
+
+std::optional<ParseError> Expression::compile(const Token* begin, const Token* end, std::pmr::memory_resource* resource)
+{
+	m_code.clear();
+	m_constants.clear();
+	m_names.clear();
+	m_max_depth	= 0;
+	m_depth		= 0;
+
+	m_begin		= begin;
+	m_cur		= begin;
+	m_end		= end;
+	m_resource	= resource;
+	m_error.reset();
+
+	parse(0);
+	if (!m_error && m_cur != m_end)
+		fail(m_cur, "unexpected " + std::string(m_cur->m_value));
+
+	if (m_error)
+		m_code.clear();
+
+	return std::move(m_error);
+}
+
+void Expression::parse(int min_power)
+{
+	parse_prefix();
+	parse_infix(min_power);
+}
+
+void Expression::parse_prefix()
+{
+	if (m_error)
+		return;
+	if (m_cur == m_end)
+	{
+		fail(m_cur, "expected an expression");
+		return;
+	}
+
+	auto& token = *m_cur;
+	std::string_view value = token.m_value;
+
+	if (is_number(token) && !value.empty() && value[0] == '-')
+	{
+		++m_cur;
+
+		// a lone "-" before a bracket comes out as an integer
+		if (value.size() == 1)
+			parse(unary_power);
+		else if (push_number(token, value.substr(1)))
+			parse_infix(unary_power);
+
+		emit(Op::negate);
+	}
+	else if (is_number(token))
+	{
+		++m_cur;
+		push_number(token, value);
+	}
+	else if (token.m_type == Token::Type::string)
+	{
+		++m_cur;
+		m_constants.push_back(Value::string(string_literal::value(token), m_resource));
+		emit(Op::constant, uint32_t(m_constants.size() - 1));
+	}
+	else if (token.m_type == Token::Type::identificator || token.m_type == Token::Type::keyword)
+	{
+		++m_cur;
+
+		if (value == "true" || value == "false" || value == "nil")
+		{
+			m_constants.push_back(value == "nil" ? Value::nil() : Value::boolean(value == "true"));
+			emit(Op::constant, uint32_t(m_constants.size() - 1));
+			return;
+		}
+
+		auto found = std::find(m_names.begin(), m_names.end(), value);
+		if (found == m_names.end())
+			found = m_names.emplace(m_names.end(), value);
+
+		emit(Op::variable, uint32_t(found - m_names.begin()));
+	}
+	else if (token.m_type == Token::Type::bracket && value == "(")
+	{
+		++m_cur;
+		parse(0);
+
+		if (m_error)
+			return;
+		if (m_cur == m_end || m_cur->m_value != ")")
+		{
+			fail(m_cur, "expected )");
+			return;
+		}
+		++m_cur;
+	}
+	else if (token.m_type == Token::Type::_operator && (value == "-" || value == "+" || value == "!" || value == "~"))
+	{
+		++m_cur;
+		parse(unary_power);
+
+		if (value == "-")
+			emit(Op::negate);
+		else if (value == "!")
+			emit(Op::logical_not);
+		else if (value == "~")
+			emit(Op::bit_not);
+	}
+	else
+		fail(m_cur, "unexpected " + std::string(value));
+}
+
+void Expression::parse_infix(int min_power)
+{
+	while (!m_error && m_cur != m_end)
+	{
+		auto& token = *m_cur;
+		std::string_view value = token.m_value;
+
+		// "2 -3" is a subtraction
+		if (is_number(token) && !value.empty() && value[0] == '-')
+		{
+			if (subtract_power < min_power)
+				return;
+			++m_cur;
+
+			if (value.size() == 1)
+				parse(subtract_power + 1);
+			else if (push_number(token, value.substr(1)))
+				parse_infix(subtract_power + 1);
+
+			emit(Op::subtract);
+			continue;
+		}
+
+		if (token.m_type != Token::Type::_operator)
+			return;
+
+		auto infix = std::find_if(
+			std::begin(infix_operators), std::end(infix_operators),
+			[&](const Infix& el) { return el.m_text == value; }
+		);
+		if (infix == std::end(infix_operators) || infix->m_power < min_power)
+			return;
+		++m_cur;
+
+		// only ** is right associative
+		auto right_power = infix->m_op == Op::power ? infix->m_power : infix->m_power + 1;
+
+		if (infix->m_op == Op::jump_if_false || infix->m_op == Op::jump_if_true)
+		{
+			auto jump = m_code.size();
+			emit(infix->m_op);
+
+			parse(right_power);
+			emit(Op::to_boolean);
+
+			m_code[jump].m_operand = uint32_t(m_code.size());
+			continue;
+		}
+
+		parse(right_power);
+		emit(infix->m_op);
+	}
+}
+
+bool Expression::push_number(const Token& token, std::string_view digits)
+{
+	auto first	= digits.data();
+	auto last	= digits.data() + digits.size();
+
+	Value value;
+	bool ok = false;
+
+	if (token.m_type == Token::Type::integer)
+	{
+		int64_t integer;
+		auto result = std::from_chars(first, last, integer);
+
+		if (result.ec == std::errc() && result.ptr == last)
+		{
+			value = Value::integer(integer, m_resource);
+			ok = true;
+		}
+		// too long for 64 bits, the nearest floating will do
+		else if (result.ec != std::errc::result_out_of_range)
+			ok = false;
+		else
+		{
+			double floating;
+			auto parsed = std::from_chars(first, last, floating);
+			value = Value::floating(floating);
+			ok = parsed.ec == std::errc() && parsed.ptr == last;
+		}
+	}
+	else
+	{
+		double floating;
+		auto parsed = std::from_chars(first, last, floating);
+		value = Value::floating(floating);
+		ok = parsed.ec == std::errc() && parsed.ptr == last;
+	}
+
+	if (!ok)
+	{
+		fail(&token, "malformed number " + std::string(token.m_value));
+		return false;
+	}
+
+	m_constants.push_back(value);
+	emit(Op::constant, uint32_t(m_constants.size() - 1));
+	return true;
+}
+
+const char* Expression::symbol(Op op)
+{
+	switch (op)
+	{
+	case Op::negate:		return "-";
+	case Op::logical_not:	return "!";
+	case Op::bit_not:		return "~";
+	case Op::add:			return "+";
+	case Op::subtract:		return "-";
+	case Op::multiply:		return "*";
+	case Op::divide:		return "/";
+	case Op::floor_divide:	return "//";
+	case Op::modulo:		return "%";
+	case Op::power:			return "**";
+	case Op::equal:			return "==";
+	case Op::not_equal:		return "!=";
+	case Op::less:			return "<";
+	case Op::less_equal:	return "<=";
+	case Op::greater:		return ">";
+	case Op::greater_equal:	return ">=";
+	case Op::bit_and:		return "&";
+	case Op::bit_or:		return "|";
+	case Op::bit_xor:		return "^";
+	case Op::shift_left:	return "<<";
+	case Op::shift_right:	return ">>";
+	case Op::jump_if_false:	return "&&";
+	case Op::jump_if_true:	return "||";
+	default:				return "operator";
+	}
+}
+
+void Expression::emit(Op op, uint32_t operand)
+{
+	m_code.push_back({ op, operand });
+
+	switch (op)
+	{
+	case Op::constant:
+	case Op::variable:
+		++m_depth;
+		break;
+	case Op::negate:
+	case Op::logical_not:
+	case Op::bit_not:
+	case Op::to_boolean:
+		break;
+	default:
+		// binary operators, and the jumps pop on the path which goes on
+		--m_depth;
+		break;
+	}
+	m_max_depth = std::max(m_max_depth, m_depth);
+}
+
+void Expression::fail(const Token* token, std::string message)
+{
+	if (!m_error)
+		m_error = ParseError{ 0, size_t(token - m_begin), std::move(message) };
+}
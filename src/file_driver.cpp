@@ -0,0 +1,91 @@
+#include "file_driver.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <numeric>
+
+namespace
+{
+	double millis_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+FileDriver::FileDriver(size_t threads)
+	: m_pool(threads), m_reader(std::max<size_t>(8, m_pool.size() * 4))
+{
+	m_workers.resize(m_pool.size());
+}
+
+std::vector<FileResult> FileDriver::run(const std::vector<std::string>& paths)
+{
+	std::vector<FileResult> results(paths.size());
+	std::vector<uintmax_t>	sizes(paths.size(), 0);
+
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		results[i].m_path = paths[i];
+
+		std::error_code error;
+		auto size = std::filesystem::file_size(paths[i], error);
+		if (!error)
+			sizes[i] = size;
+	}
+
+	std::vector<size_t> order(paths.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+	std::vector<std::string> ordered_paths;
+	ordered_paths.reserve(paths.size());
+	for (auto index : order)
+		ordered_paths.push_back(paths[index]);
+
+	// files arrive as their reads complete, the reader stays ahead of the workers
+	// until all of its buffers are waiting for a worker
+	m_reader.start(std::move(ordered_paths));
+
+	FileReader::File file;
+	while (m_reader.next(file))
+	{
+		auto& result = results[order[file.m_index]];
+		result.m_read_ms = file.m_read_ms;
+
+		if (!file.m_ok)
+		{
+			m_reader.recycle(file);
+			continue;
+		}
+
+		m_pool.submit([this, &result, file](size_t worker) mutable
+		{
+			process(m_workers[worker], result, file.m_data);
+			m_reader.recycle(file);
+		});
+	}
+	m_pool.wait();
+
+	return results;
+}
+
+void FileDriver::process(Worker& worker, FileResult& result, std::string_view data)
+{
+	TraceScope span("file");
+	auto start = std::chrono::steady_clock::now();
+
+	auto& tokenizer = worker.m_tokenizer;
+	tokenizer.reset();
+	tokenizer.feed(data);
+	tokenizer.finish();
+
+	// moving the tokens out keeps the capacity of the tokenizer's own buffer
+	result.m_tokens.reserve(tokenizer.tokens().size());
+	tokenizer.take_finished(result.m_tokens);
+	tokenizer.reset();
+
+	result.m_tokenize_ms = millis_since(start);
+	result.m_ok = true;
+}
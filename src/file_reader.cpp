@@ -0,0 +1,508 @@
+#include "file_reader.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define FILE_READER_IO_URING
+#endif
+
+/**
+	\brief Engine class opens and reads the file of a request, one implementation per backend.
+**/
+class FileReader::Engine
+{
+public:
+	virtual ~Engine() = default;
+
+	virtual Backend backend() const = 0;
+
+	// starts reading the whole file of request into its buffer
+	virtual void submit(Request& request) = 0;
+
+	// waits until some submitted request is done
+	virtual Request& wait() = 0;
+};
+
+namespace
+{
+	constexpr size_t min_buffer_size = 64 * 1024;
+
+	// a read which fills the rest of the buffer may be followed by more data
+	void grow_if_full(FileReader::Request& request)
+	{
+		auto& buffer = *request.m_buffer;
+		if (request.m_size == buffer.size())
+			buffer.resize(std::max(min_buffer_size, buffer.size() * 2));
+	}
+
+	void close_file(FileReader::Request& request)
+	{
+		if (request.m_fd >= 0)
+			::close(request.m_fd);
+		request.m_fd = -1;
+	}
+
+	// opens and reads the whole file of request with blocking calls
+	void read_file(FileReader::Request& request)
+	{
+		request.m_fd = ::open(request.m_path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (request.m_fd < 0)
+			return;
+
+		while (true)
+		{
+			grow_if_full(request);
+			auto& buffer = *request.m_buffer;
+
+			auto count = ::pread(request.m_fd, buffer.data() + request.m_size, buffer.size() - request.m_size, off_t(request.m_size));
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count < 0)
+				break;
+
+			request.m_size += size_t(count);
+			if (request.m_size < buffer.size())
+			{
+				request.m_ok = true;
+				break;
+			}
+		}
+
+		close_file(request);
+	}
+
+	class ThreadEngine : public FileReader::Engine
+	{
+	public:
+		explicit ThreadEngine(size_t threads)
+			: m_pool(threads)
+		{}
+
+		FileReader::Backend backend() const override { return FileReader::Backend::threads; }
+
+		void submit(FileReader::Request& request) override
+		{
+			m_pool.submit([this, &request](size_t)
+			{
+				read_file(request);
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_done.push_back(&request);
+				m_done_cv.notify_one();
+			});
+		}
+
+		FileReader::Request& wait() override
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done_cv.wait(lock, [this] { return !m_done.empty(); });
+
+			auto& request = *m_done.front();
+			m_done.pop_front();
+			return request;
+		}
+
+	private:
+		ThreadPool								m_pool;
+		std::mutex								m_mutex;
+		std::condition_variable					m_done_cv;
+		std::deque<FileReader::Request*>		m_done;
+	};
+
+#ifdef FILE_READER_IO_URING
+	/**
+		\brief UringEngine class drives a raw io_uring instance.
+
+		A request goes through an OPENAT and one READ per buffer-full of data, the next
+		operation is queued when the previous one completes. Queued operations are handed
+		to the kernel in one io_uring_enter call together with the wait for a completion.
+
+		If io_uring_enter fails for good, the requests still pending are read with blocking
+		calls from wait() instead.
+	**/
+	class UringEngine : public FileReader::Engine
+	{
+	public:
+		// nullptr if io_uring or the needed operations aren't available
+		static std::unique_ptr<UringEngine> create(unsigned entries)
+		{
+			std::unique_ptr<UringEngine> engine(new UringEngine());
+			if (!engine->setup(entries))
+				return nullptr;
+			return engine;
+		}
+
+		~UringEngine() override
+		{
+			if (m_sqes)
+				::munmap(m_sqes, m_sqes_size);
+			if (m_cq_ptr && m_cq_ptr != m_sq_ptr)
+				::munmap(m_cq_ptr, m_cq_size);
+			if (m_sq_ptr)
+				::munmap(m_sq_ptr, m_sq_size);
+			if (m_fd >= 0)
+				::close(m_fd);
+		}
+
+		FileReader::Backend backend() const override { return FileReader::Backend::io_uring; }
+
+		void submit(FileReader::Request& request) override
+		{
+			m_pending.push_back(&request);
+
+			auto sqe = next_sqe();
+			if (!sqe)
+				return;
+
+			sqe->opcode		= IORING_OP_OPENAT;
+			sqe->fd			= AT_FDCWD;
+			sqe->addr		= reinterpret_cast<__u64>(request.m_path.c_str());
+			sqe->open_flags	= O_RDONLY | O_CLOEXEC;
+			sqe->user_data	= reinterpret_cast<__u64>(&request);
+		}
+
+		FileReader::Request& wait() override
+		{
+			while (true)
+			{
+				io_uring_cqe cqe;
+				while (!m_broken && !pop_cqe(cqe))
+					enter(1);
+
+				if (m_broken)
+				{
+					// the ring is unusable, start the file over without it
+					auto& request = *m_pending.back();
+					m_pending.pop_back();
+
+					close_file(request);
+					request.m_size = 0;
+					read_file(request);
+					return request;
+				}
+
+				auto& request = *reinterpret_cast<FileReader::Request*>(cqe.user_data);
+
+				if (request.m_fd < 0)
+				{
+					// OPENAT completed
+					if (cqe.res < 0)
+						return done(request);
+
+					request.m_fd = cqe.res;
+					queue_read(request);
+					continue;
+				}
+
+				// READ completed
+				if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+				{
+					queue_read(request);
+					continue;
+				}
+				if (cqe.res < 0)
+				{
+					close_file(request);
+					return done(request);
+				}
+
+				request.m_size += size_t(cqe.res);
+				if (request.m_size == request.m_buffer->size())
+				{
+					queue_read(request);
+					continue;
+				}
+
+				request.m_ok = true;
+				close_file(request);
+				return done(request);
+			}
+		}
+
+	private:
+		int					m_fd = -1;
+		bool				m_broken = false;	// io_uring_enter failed with an unexpected error
+
+		std::vector<FileReader::Request*> m_pending;	// submitted and not returned by wait() yet
+
+		void*				m_sq_ptr	= nullptr;
+		void*				m_cq_ptr	= nullptr;
+		size_t				m_sq_size	= 0,
+							m_cq_size	= 0;
+		io_uring_sqe*		m_sqes		= nullptr;
+		size_t				m_sqes_size	= 0;
+
+		unsigned*			m_sq_head	= nullptr;
+		unsigned*			m_sq_tail	= nullptr;
+		unsigned*			m_sq_array	= nullptr;
+		unsigned			m_sq_mask	= 0;
+		unsigned			m_sq_entries= 0;
+		unsigned			m_to_submit	= 0;
+
+		unsigned*			m_cq_head	= nullptr;
+		unsigned*			m_cq_tail	= nullptr;
+		unsigned			m_cq_mask	= 0;
+		io_uring_cqe*		m_cqes		= nullptr;
+
+		UringEngine() = default;
+
+		bool setup(unsigned entries)
+		{
+			io_uring_params params{};
+			m_fd = int(::syscall(__NR_io_uring_setup, entries, &params));
+			if (m_fd < 0)
+				return false;
+
+			if (!supports(IORING_OP_OPENAT) || !supports(IORING_OP_READ))
+				return false;
+
+			m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+			bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+			if (single_mmap)
+				m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+
+			m_sq_ptr = map(m_sq_size, IORING_OFF_SQ_RING);
+			if (!m_sq_ptr)
+				return false;
+
+			m_cq_ptr = single_mmap ? m_sq_ptr : map(m_cq_size, IORING_OFF_CQ_RING);
+			if (!m_cq_ptr)
+				return false;
+
+			m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+			m_sqes = static_cast<io_uring_sqe*>(map(m_sqes_size, IORING_OFF_SQES));
+			if (!m_sqes)
+				return false;
+
+			auto sq = static_cast<char*>(m_sq_ptr);
+			m_sq_head	= reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+			m_sq_tail	= reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			m_sq_array	= reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			m_sq_mask	= *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			m_sq_entries= params.sq_entries;
+
+			auto cq = static_cast<char*>(m_cq_ptr);
+			m_cq_head	= reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			m_cq_tail	= reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			m_cq_mask	= *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			m_cqes		= reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+			return true;
+		}
+
+		void* map(size_t size, __u64 offset)
+		{
+			auto p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, off_t(offset));
+			return p == MAP_FAILED ? nullptr : p;
+		}
+
+		bool supports(int opcode)
+		{
+			constexpr unsigned ops = 256;
+			std::vector<char> memory(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op));
+			auto probe = reinterpret_cast<io_uring_probe*>(memory.data());
+
+			if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, ops) < 0)
+				return false;
+
+			return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+		}
+
+		FileReader::Request& done(FileReader::Request& request)
+		{
+			m_pending.erase(std::find(m_pending.begin(), m_pending.end(), &request));
+			return request;
+		}
+
+		// nullptr once the ring is broken
+		io_uring_sqe* next_sqe()
+		{
+			// the reader keeps fewer requests in flight than the ring has entries,
+			// so a full ring only means the queued ones haven't been handed over yet
+			if (m_broken)
+				return nullptr;
+
+			auto tail = *m_sq_tail;
+			if (tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) == m_sq_entries && !enter(0))
+				return nullptr;
+
+			auto index = tail & m_sq_mask;
+			auto& sqe = m_sqes[index];
+			sqe = io_uring_sqe{};
+
+			m_sq_array[index] = index;
+			__atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+			++m_to_submit;
+
+			return &sqe;
+		}
+
+		void queue_read(FileReader::Request& request)
+		{
+			grow_if_full(request);
+			auto& buffer = *request.m_buffer;
+
+			auto sqe = next_sqe();
+			if (!sqe)
+				return;
+
+			sqe->opcode		= IORING_OP_READ;
+			sqe->fd			= request.m_fd;
+			sqe->addr		= reinterpret_cast<__u64>(buffer.data() + request.m_size);
+			sqe->len		= unsigned(buffer.size() - request.m_size);
+			sqe->off		= request.m_size;
+			sqe->user_data	= reinterpret_cast<__u64>(&request);
+		}
+
+		// false, and the ring marked broken, if the kernel refuses it for good
+		bool enter(unsigned min_complete)
+		{
+			auto flags = min_complete ? IORING_ENTER_GETEVENTS : 0u;
+			while (true)
+			{
+				auto submitted = ::syscall(__NR_io_uring_enter, m_fd, m_to_submit, min_complete, flags, nullptr, 0);
+				if (submitted >= 0)
+				{
+					m_to_submit -= unsigned(submitted);
+					return true;
+				}
+				if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				{
+					m_broken = true;
+					return false;
+				}
+			}
+		}
+
+		bool pop_cqe(io_uring_cqe& cqe)
+		{
+			auto head = *m_cq_head;
+			if (head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+				return false;
+
+			cqe = m_cqes[head & m_cq_mask];
+			__atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+	};
+#endif
+}
+
+FileReader::FileReader(size_t buffers, size_t threads, bool prefer_io_uring)
+{
+	buffers = std::max<size_t>(1, buffers);
+
+#ifdef FILE_READER_IO_URING
+	if (prefer_io_uring)
+		m_engine = UringEngine::create(unsigned(buffers * 2));
+#endif
+	if (!m_engine)
+		m_engine = std::make_unique<ThreadEngine>(threads);
+
+	for (size_t i = 0; i < buffers; ++i)
+	{
+		m_buffers.push_back(std::make_unique<std::vector<char>>());
+		m_requests.push_back(std::make_unique<Request>());
+		m_free.push_back(buffers - 1 - i);
+	}
+}
+
+FileReader::~FileReader()
+{
+	// the engine may still write into the buffers
+	while (m_in_flight > 0)
+	{
+		m_engine->wait();
+		--m_in_flight;
+	}
+}
+
+FileReader::Backend FileReader::backend() const
+{
+	return m_engine->backend();
+}
+
+void FileReader::start(std::vector<std::string> paths)
+{
+	m_paths = std::move(paths);
+	m_next_path = 0;
+}
+
+void FileReader::submit_reads()
+{
+	std::lock_guard<std::mutex> lock(m_free_mutex);
+
+	while (!m_free.empty() && m_next_path < m_paths.size())
+	{
+		auto buffer = m_free.back();
+		m_free.pop_back();
+
+		auto& request = *m_requests[buffer];
+		request.m_index			= m_next_path;
+		request.m_path			= std::move(m_paths[m_next_path]);
+		request.m_buffer		= m_buffers[buffer].get();
+		request.m_buffer_index	= buffer;
+		request.m_size			= 0;
+		request.m_fd			= -1;
+		request.m_ok			= false;
+		request.m_submitted		= std::chrono::steady_clock::now();
+
+		m_engine->submit(request);
+		++m_next_path;
+		++m_in_flight;
+	}
+}
+
+bool FileReader::next(File& file)
+{
+	submit_reads();
+
+	if (m_in_flight == 0)
+	{
+		if (m_next_path == m_paths.size())
+			return false;
+
+		{
+			std::unique_lock<std::mutex> lock(m_free_mutex);
+			m_free_cv.wait(lock, [this] { return !m_free.empty(); });
+		}
+		submit_reads();
+	}
+
+	auto& request = m_engine->wait();
+	--m_in_flight;
+
+	file.m_index	= request.m_index;
+	file.m_ok		= request.m_ok;
+	file.m_data		= request.m_ok ? std::string_view(request.m_buffer->data(), request.m_size) : std::string_view();
+	file.m_buffer	= request.m_buffer_index;
+	file.m_read_ms	= std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - request.m_submitted).count();
+
+	return true;
+}
+
+void FileReader::recycle(File& file)
+{
+	if (file.m_buffer == size_t(-1))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_free_mutex);
+		m_free.push_back(file.m_buffer);
+	}
+	m_free_cv.notify_one();
+
+	file.m_buffer = size_t(-1);
+	file.m_data = {};
+}
@@ -0,0 +1,142 @@
+#include "fingerprint.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	constexpr uint64_t rolling_base = 0x100000001B3;	// the FNV prime, odd
+
+	uint64_t mix(uint64_t x)
+	{
+		x ^= x >> 30;
+		x *= 0xBF58476D1CE4E5B9;
+		x ^= x >> 27;
+		x *= 0x94D049BB133111EB;
+		x ^= x >> 31;
+		return x;
+	}
+}
+
+Fingerprinter::Fingerprinter(size_t k, size_t window)
+	: m_k(std::max<size_t>(k, 1)), m_window_size(std::max<size_t>(window, 1))
+{
+	for (size_t i = 0; i < m_k; ++i)
+		m_base_power *= rolling_base;
+
+	reset();
+}
+
+uint64_t Fingerprinter::hash(const Token& token)
+{
+	// FNV-1a of the value, seeded with the type
+	uint64_t hash = 0xCBF29CE484222325 ^ uint64_t(int(token.m_type) + 2);
+	for (unsigned char c : token.m_value)
+	{
+		hash ^= c;
+		hash *= 0x100000001B3;
+	}
+	return mix(hash);
+}
+
+void Fingerprinter::add(const Token& token)
+{
+	if (token.m_type == Token::Type::commentary || token.m_type == Token::Type::empty)
+		return;
+
+	auto hash = Fingerprinter::hash(token);
+	m_digest = mix(m_digest + hash);
+
+	// the rolling hash of the last k tokens: drop the oldest, add the newest
+	auto& slot = m_recent[m_count % m_k];
+	m_gram = m_gram * rolling_base + hash - (m_count >= m_k ? slot * m_base_power : 0);
+	slot = hash;
+	++m_count;
+
+	if (m_count >= m_k)
+		winnow(mix(m_gram), m_count - m_k);
+}
+
+void Fingerprinter::winnow(uint64_t hash, size_t position)
+{
+	m_window_end = (m_window_end + 1) % m_window_size;
+	m_window[m_window_end] = { hash, position };
+
+	// the smallest hash left the window, the rightmost smallest one takes its place
+	if (m_min == m_window_end)
+	{
+		for (auto i = (m_window_end + m_window_size - 1) % m_window_size; i != m_window_end; i = (i + m_window_size - 1) % m_window_size)
+			if (m_window[i].m_hash < m_window[m_min].m_hash)
+				m_min = i;
+
+		m_fingerprints.push_back(m_window[m_min]);
+	}
+	else if (hash <= m_window[m_min].m_hash)
+	{
+		m_min = m_window_end;
+		m_fingerprints.push_back(m_window[m_min]);
+	}
+}
+
+void Fingerprinter::finish()
+{
+	if (m_count > 0 && m_count < m_k && m_fingerprints.empty())
+		m_fingerprints.push_back({ mix(m_gram), 0 });
+}
+
+void Fingerprinter::reset()
+{
+	m_recent.assign(m_k, 0);
+	m_gram		= 0;
+	m_count		= 0;
+	m_digest	= 0;
+
+	// empty slots never win against a real hash
+	m_window.assign(m_window_size, { UINT64_MAX, 0 });
+	m_window_end	= 0;
+	m_min			= 0;
+
+	m_fingerprints.clear();
+}
+
+std::vector<CloneIndex::Match> CloneIndex::add(const Fingerprinter& document, double min_similarity)
+{
+	std::vector<uint64_t> hashes;
+	hashes.reserve(document.fingerprints().size());
+	for (auto& fingerprint : document.fingerprints())
+		hashes.push_back(fingerprint.m_hash);
+
+	std::sort(hashes.begin(), hashes.end());
+	hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+	// fingerprints shared with every earlier document
+	std::unordered_map<uint32_t, size_t> shared;
+	for (auto hash : hashes)
+	{
+		auto& documents = m_postings[hash];
+		for (auto other : documents)
+			++shared[other];
+		documents.push_back(uint32_t(m_documents.size()));
+	}
+
+	std::vector<Match> matches;
+	for (auto [other, count] : shared)
+	{
+		auto& earlier = m_documents[other];
+
+		Match match;
+		match.m_document	= other;
+		match.m_exact		= earlier.m_digest == document.digest() && earlier.m_tokens == document.token_count();
+		match.m_similarity	= match.m_exact ? 1 : double(count) / double(hashes.size() + earlier.m_fingerprints - count);
+
+		if (match.m_similarity >= min_similarity)
+			matches.push_back(match);
+	}
+
+	std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b)
+	{
+		return a.m_similarity != b.m_similarity ? a.m_similarity > b.m_similarity : a.m_document < b.m_document;
+	});
+
+	m_documents.push_back({ document.digest(), document.token_count(), hashes.size() });
+	return matches;
+}
@@ -1,8 +1,29 @@
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
 
 #include "tokenizer.hpp"
+#include "batch_expression.hpp"
+#include "command_line.hpp"
+#include "evaluator.hpp"
+#include "file_driver.hpp"
+#include "fingerprint.hpp"
+#include "server.hpp"
+#include "token_index.hpp"
+#include "token_spool.hpp"
+#include "token_writer.hpp"
+#include "trace.hpp"
 
-void print_tokens(const std::vector<Token>& tokens)
+#include <unistd.h>
+
+void print_tokens(const std::pmr::vector<Token>& tokens)
 {
 	for (auto& el : tokens)
 	{
@@ -40,18 +61,409 @@ void print_tokens(const std::vector<Token>& tokens)
 
 }
 
-int main()
+int tokenize_files(const std::vector<std::string>& paths, size_t threads)
+{
+	FileDriver driver(threads);
+	auto results = driver.run(paths);
+
+	int status = 0;
+	size_t total_tokens = 0;
+	double total_ms = 0;
+
+	for (auto& result : results)
+	{
+		if (!result.m_ok)
+		{
+			std::cerr << result.m_path << ": can't read the file\n";
+			status = 1;
+			continue;
+		}
+
+		std::cout	<< result.m_path << ": " << result.m_tokens.size() << " tokens, "
+					<< "read " << result.m_read_ms << " ms, "
+					<< "tokenize " << result.m_tokenize_ms << " ms\n";
+
+		total_tokens += result.m_tokens.size();
+		total_ms += result.m_read_ms + result.m_tokenize_ms;
+	}
+	std::cout << results.size() << " files, " << total_tokens << " tokens, " << total_ms << " ms of work\n";
+
+	return status;
+}
+
+int index_files(const std::string& index_path, const std::vector<std::string>& paths, size_t threads)
+{
+	TokenIndex index(index_path);
+	if (!index.update(paths, threads))
+	{
+		std::cerr << index_path << ": can't update the index\n";
+		return 1;
+	}
+
+	auto& stats = index.last_update();
+	std::cout	<< index.file_count() << " files, " << index.term_count() << " terms, "
+				<< stats.m_tokenized << " tokenized, " << stats.m_reused << " unchanged, "
+				<< stats.m_failed << " unreadable\n";
+
+	return stats.m_failed ? 1 : 0;
+}
+
+int find_in_index(const std::string& index_path, const std::vector<std::string>& terms)
+{
+	TokenIndex index(index_path);
+	if (!index.open())
+	{
+		std::cerr << index_path << ": can't open the index\n";
+		return 1;
+	}
+
+	for (auto& term : terms)
+		for (auto& location : index.find(term))
+			std::cout << location.m_file << ":" << location.m_line << ":" << location.m_col << ": " << term << "\n";
+
+	return 0;
+}
+
+int find_clones(const std::vector<std::string>& paths)
+{
+	Tokenizer tokenizer;
+	Fingerprinter fingerprinter;
+	CloneIndex index;
+	tokenizer.fingerprint(&fingerprinter);
+
+	std::vector<std::string> indexed;
+	std::pmr::vector<Token> finished;
+	int status = 0;
+
+	for (auto& path : paths)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << path << ": can't read the file\n";
+			status = 1;
+			continue;
+		}
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		// only the fingerprints are needed, the tokens are dropped as they come
+		tokenizer.reset();
+		std::string_view rest = data;
+		while (!rest.empty())
+		{
+			rest.remove_prefix(tokenizer.tokenize_some(rest, 64 * 1024));
+			tokenizer.take_finished(finished);
+			finished.clear();
+		}
+		tokenizer.finish();
+
+		for (auto& match : index.add(fingerprinter))
+			std::cout	<< path << ": " << (match.m_exact ? "clone of " : "similar to ") << indexed[match.m_document]
+						<< " (" << int(match.m_similarity * 100) << "%)\n";
+		indexed.push_back(path);
+	}
+
+	return status;
+}
+
+int tokenize_external(const std::string& path, size_t memory_limit)
+{
+	std::ifstream file;
+	if (path != "-")
+	{
+		file.open(path, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << path << ": can't read the file\n";
+			return 1;
+		}
+	}
+	std::istream& input = path == "-" ? std::cin : file;
+
+	Tokenizer tokenizer;
+	TokenSpool spool(memory_limit);
+	{
+		TraceScope span("tokenize");
+		if (!spool.tokenize(input, tokenizer))
+		{
+			std::cerr << path << ": can't spill the tokens\n";
+			return 1;
+		}
+	}
+
+	size_t invalid = 0;
+	{
+		TraceScope span("read back");
+
+		auto reader = spool.reader();
+		Token token;
+		while (reader.next(token))
+			invalid += token.m_type == Token::Type::invalid;
+
+		if (reader.failed())
+		{
+			std::cerr << path << ": can't read the spilled tokens\n";
+			return 1;
+		}
+	}
+
+	std::cout	<< path << ": " << spool.size() << " tokens, " << invalid << " invalid, "
+				<< spool.spilled_bytes() << " bytes spilled\n";
+
+	return 0;
+}
+
+// tokenizes stdin and writes the tokens back to stdout in style
+int rewrite(TokenWriter::Style style)
+{
+	Tokenizer tokenizer;
+	TokenWriter writer(STDOUT_FILENO, style);
+	std::pmr::vector<Token> finished;
+
+	bool written = tokenizer.feed_stream(std::cin, 64 * 1024, finished, [&]
+	{
+		bool ok = writer.write(finished);
+		finished.clear();
+		return ok;
+	});
+
+	if (!written || !writer.finish())
+	{
+		std::cerr << "can't write the tokens: " << std::strerror(errno) << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+// evaluates the expression over rows of the columns i = 0, 1, 2... and x = i / 2.0
+void evaluate_columns(const Token* begin, const Token* end, size_t rows)
+{
+	Region region;
+	Expression expression;
+	if (auto error = expression.compile(begin, end, &region))
+	{
+		std::cout << "error: " << error->m_message << "\n";
+		return;
+	}
+
+	static std::vector<int64_t> i;
+	static std::vector<double> x;
+	for (auto row = i.size(); row < rows; ++row)
+	{
+		i.push_back(int64_t(row));
+		x.push_back(double(row) / 2);
+	}
+
+	BatchExpression batch;
+	std::string error;
+	if (!batch.compile(expression, { { "i", BatchExpression::Type::integer }, { "x", BatchExpression::Type::floating } }, error))
+	{
+		std::cout << "error: " << error << "\n";
+		return;
+	}
+
+	std::vector<uint64_t> out(rows);
+	auto start = std::chrono::steady_clock::now();
+	bool ok;
+	{
+		TraceScope span("evaluate");
+		ok = batch.run({ i.data(), x.data() }, rows, out.data(), error);
+	}
+	auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (!ok)
+	{
+		std::cout << "error: " << error << "\n";
+		return;
+	}
+
+	std::cout << rows << " rows in " << ms << " ms:";
+	for (size_t row = 0; row < rows && row < 5; ++row)
+	{
+		std::cout << " ";
+		switch (batch.result_type())
+		{
+		case BatchExpression::Type::integer:
+			std::cout << reinterpret_cast<const int64_t*>(out.data())[row];
+			break;
+		case BatchExpression::Type::floating:
+			std::cout << Value::floating(reinterpret_cast<const double*>(out.data())[row]);
+			break;
+		case BatchExpression::Type::boolean:
+			std::cout << (reinterpret_cast<const uint8_t*>(out.data())[row] ? "true" : "false");
+			break;
+		}
+	}
+	std::cout << (rows > 5 ? " ...\n" : "\n");
+}
+
+int repl(bool evaluate, size_t rows)
 {
 	Tokenizer tokenizer;
+	Evaluator evaluator;
+	Value result;
+	ParseError error;
 
 	std::string line;
-	while (std::getline(std::cin, line))
+	while (true)
 	{
-		tokenizer.tokenize(line);
-		print_tokens(tokenizer.tokens());
+		{
+			TraceScope span("read");
+			if (!std::getline(std::cin, line))
+				break;
+		}
+
+		TraceScope span("line");
+		{
+			TraceScope span("tokenize");
+			tokenizer.tokenize(line);
+		}
+		if (evaluate)
+		{
+			auto& tokens = tokenizer.tokens();
+
+			// the rest of the line after a commentary starts isn't part of the expression
+			auto end = std::find_if(tokens.begin(), tokens.end(),
+				[](const Token& token) { return token.m_type == Token::Type::commentary; });
+
+			if (rows > 0)
+				evaluate_columns(tokens.data(), tokens.data() + (end - tokens.begin()), rows);
+			else if (!evaluator.run(tokens.data(), tokens.data() + (end - tokens.begin()), result, error))
+			{
+				std::cout << "error";
+				if (error.m_token < tokens.size())
+					std::cout << " at column " << tokens[error.m_token].m_col;
+				std::cout << ": " << error.m_message << "\n";
+			}
+			else if (end != tokens.begin())
+				std::cout << result << "\n";
+		}
+		else
+		{
+			TraceScope span("print");
+			print_tokens(tokenizer.tokens());
+		}
 		tokenizer.reset();
 	}
 
+	return 0;
+}
+
+static Server* g_server = nullptr;
+
+static void stop_server(int)
+{
+	if (g_server)
+		g_server->stop();
+}
+
+int serve(const std::string& socket_path, size_t threads)
+{
+	Server server(socket_path, threads);
+	if (!server.listen())
+	{
+		std::cerr << socket_path << ": " << std::strerror(errno) << "\n";
+		return 1;
+	}
+
+	g_server = &server;
+	std::signal(SIGINT, stop_server);
+	std::signal(SIGTERM, stop_server);
+
+	server.run();
+
+	std::signal(SIGINT, SIG_DFL);
+	std::signal(SIGTERM, SIG_DFL);
+	g_server = nullptr;
 
 	return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::string trace_path;
+	std::string socket_path;
+	std::string external_path;
+	std::string index_path;
+	std::vector<std::string> terms;
+	size_t memory_limit = 64;
+	size_t threads = 0;
+	bool files_mode = false;
+	bool evaluate = false;
+	bool clones = false;
+	size_t rows = 0;
+	bool minify = false;
+	bool format = false;
+	bool usage = false;
+
+	for (int i = 1; i < argc && !usage; ++i)
+	{
+		if (std::strcmp(argv[i], "--files") == 0)
+			files_mode = true;
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			usage = !command_line::parse_count(argv[++i], threads);
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			trace_path = argv[++i];
+		else if (std::strcmp(argv[i], "--clones") == 0)
+			clones = true;
+		else if (std::strcmp(argv[i], "--eval") == 0)
+			evaluate = true;
+		else if (std::strcmp(argv[i], "--minify") == 0)
+			minify = true;
+		else if (std::strcmp(argv[i], "--format") == 0)
+			format = true;
+		else if (std::strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+			usage = !command_line::parse_count(argv[++i], rows);
+		else if (std::strcmp(argv[i], "--index") == 0 && i + 1 < argc)
+			index_path = argv[++i];
+		else if (std::strcmp(argv[i], "--find") == 0 && i + 1 < argc)
+			terms.push_back(argv[++i]);
+		else if (std::strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc)
+			usage = !command_line::parse_count(argv[++i], memory_limit);
+		else if (std::strcmp(argv[i], "--external") == 0 && i + 1 < argc)
+			external_path = argv[++i];
+		else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+			socket_path = argv[++i];
+		else if (files_mode)
+			files.push_back(argv[i]);
+		else
+			usage = true;
+	}
+
+	if (usage)
+	{
+		std::cerr << "usage: " << argv[0] << " [--trace TRACE.json] [--threads N] [--memory-limit MiB] [--index INDEX] [--find TOKEN]... [--clones] [--eval [--rows N] | --minify | --format | --serve SOCKET | --external FILE | --files FILE...]\n";
+		return 2;
+	}
+
+	if (!trace_path.empty())
+		Tracer::instance().enable(true);
+
+	int status;
+	if (!socket_path.empty())
+		status = serve(socket_path, threads);
+	else if (minify || format)
+		status = rewrite(minify ? TokenWriter::Style::minified : TokenWriter::Style::canonical);
+	else if (!external_path.empty())
+		status = tokenize_external(external_path, memory_limit * 1024 * 1024);
+	else if (clones && files_mode)
+		status = find_clones(files);
+	else if (!index_path.empty() && files_mode)
+		status = index_files(index_path, files, threads);
+	else if (!index_path.empty())
+		status = find_in_index(index_path, terms);
+	else if (files_mode)
+		status = tokenize_files(files, threads);
+	else
+		status = repl(evaluate, rows);
+
+	if (!trace_path.empty())
+	{
+		std::ofstream trace(trace_path);
+		Tracer::instance().write_chrome_trace(trace);
+		Tracer::instance().write_summary(std::cerr);
+	}
+
+	return status;
+}
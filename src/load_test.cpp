@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "client.hpp"
+#include "command_line.hpp"
+#include "trace.hpp"
+
+int main(int argc, char* argv[])
+{
+	std::string socket_path;
+	std::string source;
+	size_t requests	= 10000;
+	size_t batch	= 16;
+	auto op			= protocol::Op::tokenize;
+
+	bool usage = false;
+
+	for (int i = 1; i < argc && !usage; ++i)
+	{
+		if (std::strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+			usage = !command_line::parse_count(argv[++i], requests);
+		else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			usage = !command_line::parse_count(argv[++i], batch) || batch == 0;
+		else if (std::strcmp(argv[i], "--statements") == 0)
+			op = protocol::Op::statements;
+		else if (std::strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+		{
+			std::ifstream file(argv[++i], std::ios::binary);
+			std::stringstream content;
+			content << file.rdbuf();
+			source = content.str();
+		}
+		else if (socket_path.empty() && argv[i][0] != '-')
+			socket_path = argv[i];
+		else
+			usage = true;
+	}
+	if (usage || socket_path.empty())
+	{
+		std::cerr << "usage: " << argv[0] << " SOCKET [--requests N] [--batch N] [--statements] [--file SOURCE]\n";
+		return 2;
+	}
+	if (source.empty())
+		source = "total = (price * quantity) // 3 + tax ** 2; name = \"item\\t1\"; # comment\n";
+
+	Client client;
+	if (!client.connect(socket_path))
+	{
+		std::cerr << socket_path << ": " << std::strerror(errno) << "\n";
+		return 1;
+	}
+
+	std::vector<protocol::Request>	calls;
+	std::vector<protocol::Response>	responses;
+	LatencyHistogram				latency;
+	size_t							tokens = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t done = 0; done < requests; done += calls.size())
+	{
+		calls.clear();
+		for (size_t i = 0; i < batch && done + i < requests; ++i)
+			calls.push_back({ done + i, op, source });
+
+		auto call_start = std::chrono::steady_clock::now();
+		if (!client.call(calls, responses))
+		{
+			std::cerr << "connection failed after " << done << " requests\n";
+			return 1;
+		}
+		latency.record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - call_start).count()));
+
+		for (auto& response : responses)
+			tokens += response.m_tokens.size();
+	}
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout	<< requests << " requests in " << seconds << " s, "
+				<< double(requests) / seconds << " requests/s, "
+				<< double(requests * source.size()) / seconds / (1024 * 1024) << " MiB/s, "
+				<< tokens << " tokens\n"
+				<< "batch latency: "
+				<< "p50 "	<< double(latency.percentile(0.5)) / 1000	<< " us, "
+				<< "p99 "	<< double(latency.percentile(0.99)) / 1000	<< " us, "
+				<< "p999 "	<< double(latency.percentile(0.999)) / 1000	<< " us\n";
+
+	return 0;
+}
@@ -0,0 +1,34 @@
+#include "parallel_parse.hpp"
+
+std::vector<StatementRange> split_statements(const std::pmr::vector<Token>& tokens)
+{
+	std::vector<StatementRange> ranges;
+
+	size_t depth = 0;
+	size_t begin = 0;
+
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		auto& token = tokens[i];
+
+		if (token.m_type == Token::Type::bracket)
+		{
+			auto bracket = token.m_value[0];
+			if (bracket == '(' || bracket == '{' || bracket == '[')
+				++depth;
+			else if (depth > 0)
+				--depth;
+		}
+		else if (depth == 0 && token.m_type == Token::Type::_operator && token.m_value == ";")
+		{
+			if (i > begin)
+				ranges.push_back({ begin, i });
+			begin = i + 1;
+		}
+	}
+
+	if (tokens.size() > begin)
+		ranges.push_back({ begin, tokens.size() });
+
+	return ranges;
+}
@@ -0,0 +1,120 @@
+#include "pipeline.hpp"
+#include "utf8.hpp"
+
+#include <algorithm>
+
+TokenPipeline::TokenPipeline(size_t batch_size, size_t ring_capacity, size_t chunk_size)
+	: m_ring(ring_capacity), m_batch_size(batch_size), m_chunk_size(chunk_size)
+{}
+
+TokenPipeline::~TokenPipeline()
+{
+	stop();
+}
+
+void TokenPipeline::start(std::string_view input)
+{
+	stop();
+
+	m_tokenizer.reset();
+	m_done.store(false, std::memory_order_relaxed);
+	m_stop.store(false, std::memory_order_relaxed);
+	m_producer = std::thread(&TokenPipeline::produce, this, input);
+}
+
+bool TokenPipeline::pop(Batch& batch)
+{
+	while (true)
+	{
+		if (auto popped = m_ring.try_pop())
+		{
+			batch = std::move(*popped);
+			return true;
+		}
+
+		// the producer could push its last batch right before setting m_done
+		if (m_done.load(std::memory_order_acquire))
+		{
+			if (auto popped = m_ring.try_pop())
+			{
+				batch = std::move(*popped);
+				return true;
+			}
+			return false;
+		}
+
+		std::this_thread::yield();
+	}
+}
+
+void TokenPipeline::join()
+{
+	if (m_producer.joinable())
+		m_producer.join();
+}
+
+void TokenPipeline::stop()
+{
+	m_stop.store(true, std::memory_order_relaxed);
+	join();
+
+	while (m_ring.try_pop())
+		;
+}
+
+bool TokenPipeline::push_batch(Batch& batch)
+{
+	// a full ring is left alone only by a consumer popping or by stop()
+	while (!m_ring.try_push(std::move(batch)))
+	{
+		if (m_stop.load(std::memory_order_relaxed))
+			return false;
+		std::this_thread::yield();
+	}
+
+	batch = Batch();
+	batch.reserve(m_batch_size);
+	return true;
+}
+
+void TokenPipeline::produce(std::string_view input)
+{
+	Batch pending;
+	Batch batch;
+	batch.reserve(m_batch_size);
+
+	auto flush = [&](bool all)
+	{
+		for (auto& token : pending)
+		{
+			batch.push_back(std::move(token));
+			if (batch.size() == m_batch_size && !push_batch(batch))
+				return false;
+		}
+		pending.clear();
+
+		return !all || batch.empty() || push_batch(batch);
+	};
+
+	bool stopped = false;
+	for (size_t pos = 0, end; pos < input.size() && !stopped; pos = end)
+	{
+		end = std::min(pos + m_chunk_size, input.size());
+		// don't split a character between two feeds unless the chunk is too short to hold it
+		if (auto boundary = utf8::floor_boundary(input, end); boundary > pos)
+			end = boundary;
+
+		m_tokenizer.feed(input.substr(pos, end - pos));
+		m_tokenizer.take_finished(pending);
+		stopped = !flush(false) || m_stop.load(std::memory_order_relaxed);
+	}
+
+	if (!stopped)
+	{
+		m_tokenizer.finish();
+		m_tokenizer.take_finished(pending);
+		flush(true);
+	}
+
+	m_done.store(true, std::memory_order_release);
+}
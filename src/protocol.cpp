@@ -0,0 +1,226 @@
+#include "protocol.hpp"
+
+namespace
+{
+	void write_u32(std::string& out, size_t pos, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+			out[pos + i] = char((value >> (8 * i)) & 0xFF);
+	}
+
+	uint32_t read_u32(const char* data)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < 4; ++i)
+			value |= uint32_t(static_cast<unsigned char>(data[i])) << (8 * i);
+		return value;
+	}
+
+	// reserves the length field, finish_frame() fills it in
+	size_t begin_frame(std::string& out)
+	{
+		auto pos = out.size();
+		out.append(4, '\0');
+		return pos;
+	}
+
+	void finish_frame(std::string& out, size_t pos)
+	{
+		write_u32(out, pos, uint32_t(out.size() - pos - 4));
+	}
+
+	// size of the frame at the start of buffer, 0 if incomplete
+	size_t frame_size(std::string_view buffer, bool& malformed)
+	{
+		malformed = false;
+		if (buffer.size() < 4)
+			return 0;
+
+		size_t length = read_u32(buffer.data());
+		if (length > protocol::max_frame)
+		{
+			malformed = true;
+			return protocol::broken_stream;
+		}
+
+		return buffer.size() < 4 + length ? 0 : 4 + length;
+	}
+}
+
+void protocol::write_varint(std::string& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out += char((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	out += char(value);
+}
+
+bool protocol::read_varint(const char*& cur, const char* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && cur < end; shift += 7)
+	{
+		auto byte = static_cast<unsigned char>(*cur++);
+		value |= uint64_t(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+void protocol::write_token(std::string& out, const Token& token)
+{
+	out += char(int(token.m_type));
+	out += char(token.m_has_escapes ? 1 : 0);
+	write_varint(out, token.m_line);
+	write_varint(out, token.m_col);
+	write_varint(out, token.m_value.size());
+	out.append(token.m_value.data(), token.m_value.size());
+}
+
+bool protocol::read_token(const char*& cur, const char* end, Token& token)
+{
+	if (end - cur < 2)
+		return false;
+
+	auto type = static_cast<signed char>(*cur++);
+	auto flags = static_cast<unsigned char>(*cur++);
+	if (type < int(Token::Type::empty) || type > int(Token::Type::_operator))
+		return false;
+
+	uint64_t line, col, size;
+	if (!read_varint(cur, end, line) || !read_varint(cur, end, col) || !read_varint(cur, end, size))
+		return false;
+	if (size > uint64_t(end - cur))
+		return false;
+
+	token.m_type		= Token::Type(type);
+	token.m_has_escapes	= flags & 1;
+	token.m_line		= size_t(line);
+	token.m_col			= size_t(col);
+	token.m_value.assign(cur, size_t(size));
+	cur += size;
+
+	return true;
+}
+
+void protocol::write_request(std::string& out, const Request& request)
+{
+	auto frame = begin_frame(out);
+	write_varint(out, request.m_id);
+	out += char(request.m_op);
+	out.append(request.m_source.data(), request.m_source.size());
+	finish_frame(out, frame);
+}
+
+void protocol::write_response(
+	std::string& out,
+	uint64_t id,
+	Status status,
+	const std::pmr::vector<Token>& tokens,
+	const std::vector<StatementRange>* statements
+)
+{
+	auto frame = begin_frame(out);
+	write_varint(out, id);
+	out += char(status);
+
+	write_varint(out, tokens.size());
+	for (auto& token : tokens)
+		write_token(out, token);
+
+	if (statements)
+	{
+		write_varint(out, statements->size());
+		for (auto& range : *statements)
+		{
+			write_varint(out, range.m_begin);
+			write_varint(out, range.m_end);
+		}
+	}
+
+	finish_frame(out, frame);
+}
+
+size_t protocol::read_request(std::string_view buffer, Request& request, bool& malformed)
+{
+	auto size = frame_size(buffer, malformed);
+	if (size == 0 || size == broken_stream)
+		return size;
+
+	auto cur = buffer.data() + 4;
+	auto end = buffer.data() + size;
+
+	if (!read_varint(cur, end, request.m_id) || cur == end)
+	{
+		malformed = true;
+		return size;
+	}
+
+	request.m_op = Op(*cur++);
+	if (request.m_op != Op::tokenize && request.m_op != Op::statements)
+		malformed = true;
+
+	request.m_source = std::string_view(cur, size_t(end - cur));
+	return size;
+}
+
+size_t protocol::read_response(std::string_view buffer, Op op, Response& response, bool& malformed)
+{
+	auto size = frame_size(buffer, malformed);
+	if (size == 0 || size == broken_stream)
+		return size;
+
+	auto cur = buffer.data() + 4;
+	auto end = buffer.data() + size;
+
+	uint64_t count;
+	if (!read_varint(cur, end, response.m_id) || cur == end)
+	{
+		malformed = true;
+		return size;
+	}
+	response.m_status = Status(*cur++);
+
+	response.m_tokens.clear();
+	response.m_statements.clear();
+
+	if (!read_varint(cur, end, count))
+	{
+		malformed = true;
+		return size;
+	}
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		Token token;
+		if (!read_token(cur, end, token))
+		{
+			malformed = true;
+			return size;
+		}
+		response.m_tokens.push_back(std::move(token));
+	}
+
+	if (op == Op::statements && response.m_status == Status::ok)
+	{
+		if (!read_varint(cur, end, count))
+		{
+			malformed = true;
+			return size;
+		}
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			uint64_t begin, range_end;
+			if (!read_varint(cur, end, begin) || !read_varint(cur, end, range_end))
+			{
+				malformed = true;
+				return size;
+			}
+			response.m_statements.push_back({ size_t(begin), size_t(range_end) });
+		}
+	}
+
+	return size;
+}
@@ -0,0 +1,80 @@
+#include "region.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+Region::Region(size_t block_size, std::pmr::memory_resource* upstream)
+	: m_upstream(upstream), m_block_size(block_size)
+{}
+
+Region::~Region()
+{
+	for (auto& block : m_blocks)
+		m_upstream->deallocate(block.m_data, block.m_size, alignof(std::max_align_t));
+}
+
+void Region::rollback(Mark mark)
+{
+	if (m_blocks.empty())
+		return;
+
+	for (auto i = mark.m_block + 1; i <= m_current; ++i)
+		m_blocks[i].m_used = 0;
+
+	m_current = mark.m_block;
+	m_blocks[m_current].m_used = mark.m_used;
+}
+
+size_t Region::bytes_used() const
+{
+	size_t used = 0;
+	for (size_t i = 0; i <= m_current && i < m_blocks.size(); ++i)
+		used += m_blocks[i].m_used;
+	return used;
+}
+
+size_t Region::bytes_reserved() const
+{
+	size_t reserved = 0;
+	for (auto& block : m_blocks)
+		reserved += block.m_size;
+	return reserved;
+}
+
+void* Region::do_allocate(size_t bytes, size_t alignment)
+{
+	auto fits = [&](Block& block) -> void*
+	{
+		auto start = (reinterpret_cast<uintptr_t>(block.m_data) + block.m_used + alignment - 1) & ~uintptr_t(alignment - 1);
+		auto end = start + bytes;
+		if (end > reinterpret_cast<uintptr_t>(block.m_data) + block.m_size)
+			return nullptr;
+
+		block.m_used = end - reinterpret_cast<uintptr_t>(block.m_data);
+		return reinterpret_cast<void*>(start);
+	};
+
+	if (!m_blocks.empty())
+	{
+		if (auto pointer = fits(m_blocks[m_current]))
+			return pointer;
+
+		// the next block is empty, it was kept from before a rollback
+		if (m_current + 1 < m_blocks.size())
+			if (auto pointer = fits(m_blocks[m_current + 1]))
+			{
+				++m_current;
+				return pointer;
+			}
+	}
+
+	Block block;
+	block.m_size = std::max(m_block_size, bytes + alignment);
+	block.m_data = static_cast<char*>(m_upstream->allocate(block.m_size, alignof(std::max_align_t)));
+
+	// a new block goes right after the current one, the empty ones stay behind it
+	m_current = m_blocks.empty() ? 0 : m_current + 1;
+	m_blocks.insert(m_blocks.begin() + m_current, block);
+
+	return fits(m_blocks[m_current]);
+}
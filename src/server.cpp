@@ -0,0 +1,334 @@
+#include "server.hpp"
+#include "protocol.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr size_t read_size = 64 * 1024;
+	// a busy connection is re-armed after this much so the others get their turn
+	constexpr size_t batch_limit = 1024 * 1024;
+
+	// false if the peer is gone or stop_fd became readable while the socket was full
+	bool write_all(int fd, const char* data, size_t size, int stop_fd)
+	{
+		while (size > 0)
+		{
+			auto written = ::send(fd, data, size, MSG_NOSIGNAL);
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				pollfd fds[2] =
+				{
+					{ fd,		POLLOUT, 0 },
+					{ stop_fd,	POLLIN, 0 },
+				};
+				if (::poll(fds, 2, -1) < 0 && errno != EINTR)
+					return false;
+				if (fds[1].revents)
+					return false;
+				continue;
+			}
+			if (written <= 0)
+				return false;
+
+			data += written;
+			size -= size_t(written);
+		}
+		return true;
+	}
+
+	bool watch(int epoll_fd, int fd, int operation, uint32_t events)
+	{
+		epoll_event event{};
+		event.events = events;
+		event.data.fd = fd;
+		return ::epoll_ctl(epoll_fd, operation, fd, &event) == 0;
+	}
+
+	constexpr uint32_t connection_events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+}
+
+Server::Server(std::string socket_path, size_t threads)
+	: m_socket_path(std::move(socket_path)), m_pool(threads)
+{
+	m_workers.resize(m_pool.size());
+}
+
+Server::~Server()
+{
+	stop();
+
+	// tasks in flight give up on writes once the stop pipe is readable
+	m_pool.wait();
+
+	for (auto& [fd, connection] : m_connections)
+		::close(fd);
+	m_connections.clear();
+
+	if (m_listen_fd >= 0)
+	{
+		::close(m_listen_fd);
+		::unlink(m_socket_path.c_str());
+	}
+	if (m_epoll_fd >= 0)
+		::close(m_epoll_fd);
+	for (auto fd : m_stop_pipe)
+		if (fd >= 0)
+			::close(fd);
+}
+
+bool Server::listen()
+{
+	sockaddr_un address{};
+	if (m_socket_path.size() >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return false;
+	}
+
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, m_socket_path.c_str(), m_socket_path.size() + 1);
+
+	if (::pipe2(m_stop_pipe, O_CLOEXEC) < 0)
+		return false;
+
+	m_epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+	if (m_epoll_fd < 0)
+		return false;
+
+	m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (m_listen_fd < 0)
+		return false;
+
+	// a socket file left behind by a previous run would make bind fail
+	::unlink(m_socket_path.c_str());
+
+	if (::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+		return false;
+
+	return	::listen(m_listen_fd, SOMAXCONN) == 0 &&
+			watch(m_epoll_fd, m_listen_fd, EPOLL_CTL_ADD, EPOLLIN) &&
+			watch(m_epoll_fd, m_stop_pipe[0], EPOLL_CTL_ADD, EPOLLIN);
+}
+
+void Server::run()
+{
+	epoll_event events[64];
+
+	bool stopping = false;
+	while (!stopping)
+	{
+		auto count = ::epoll_wait(m_epoll_fd, events, int(std::size(events)), -1);
+		if (count < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			int fd = events[i].data.fd;
+			if (fd == m_stop_pipe[0])
+				stopping = true;
+			else if (fd == m_listen_fd)
+				accept_all();
+			else
+			{
+				Connection* connection;
+				{
+					std::lock_guard<std::mutex> lock(m_connections_mutex);
+					connection = m_connections.at(fd).get();
+				}
+
+				// the connection stays disarmed until the task is done with it
+				m_pool.submit([this, connection](size_t worker)
+				{
+					if (serve(m_workers[worker], *connection))
+					{
+						if (watch(m_epoll_fd, connection->m_fd, EPOLL_CTL_MOD, connection_events))
+							return;
+					}
+					close_connection(connection->m_fd);
+				});
+			}
+		}
+	}
+
+	m_pool.wait();
+}
+
+void Server::stop()
+{
+	if (m_stop_pipe[1] >= 0)
+	{
+		char byte = 0;
+		while (::write(m_stop_pipe[1], &byte, 1) < 0 && errno == EINTR)
+			;
+	}
+}
+
+void Server::accept_all()
+{
+	while (true)
+	{
+		int fd = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+		if (fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			// the listen socket stays readable, watching it would wake run() in a loop
+			// until close_connection() frees a descriptor and watches it again
+			bool out_of_descriptors = errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM;
+			if (out_of_descriptors && !m_accept_paused)
+			{
+				watch(m_epoll_fd, m_listen_fd, EPOLL_CTL_MOD, 0);
+				m_accept_paused = true;
+
+				// a descriptor freed before the flag was set is taken here
+				continue;
+			}
+			return;
+		}
+
+		if (m_accept_paused.exchange(false))
+			watch(m_epoll_fd, m_listen_fd, EPOLL_CTL_MOD, EPOLLIN);
+
+		auto connection = std::make_unique<Connection>();
+		connection->m_fd = fd;
+		{
+			std::lock_guard<std::mutex> lock(m_connections_mutex);
+			m_connections[fd] = std::move(connection);
+		}
+
+		if (!watch(m_epoll_fd, fd, EPOLL_CTL_ADD, connection_events))
+			close_connection(fd);
+	}
+}
+
+void Server::close_connection(int fd)
+{
+	// erased before closing, the number may be handed out again by the next accept
+	{
+		std::lock_guard<std::mutex> lock(m_connections_mutex);
+		m_connections.erase(fd);
+	}
+	::close(fd);
+
+	if (m_accept_paused.exchange(false))
+		watch(m_epoll_fd, m_listen_fd, EPOLL_CTL_MOD, EPOLLIN);
+}
+
+bool Server::serve(Worker& worker, Connection& connection)
+{
+	// the pending bytes move into the worker buffer instead of being copied, so a frame
+	// arriving in many reads is appended to rather than copied again on every one
+	auto& input = worker.m_input;
+	input.clear();
+	if (!connection.m_pending.empty())
+		input.swap(connection.m_pending);
+
+	bool closed = false;
+	for (size_t received = 0; received < batch_limit; )
+	{
+		auto size = input.size();
+		input.resize(size + read_size);
+
+		auto count = ::recv(connection.m_fd, input.data() + size, read_size, 0);
+		input.resize(size + size_t(std::max<ssize_t>(count, 0)));
+
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (count < 0)
+			return false;
+		// the frames sent before the end of the stream are still answered
+		if (count == 0)
+		{
+			closed = true;
+			break;
+		}
+		received += size_t(count);
+	}
+
+	size_t used = 0;
+	worker.m_output.clear();
+	bool keep = answer(worker, input, used);
+
+	if (!worker.m_output.empty() && !write_all(connection.m_fd, worker.m_output.data(), worker.m_output.size(), m_stop_pipe[0]))
+		return false;
+
+	// only the start of a frame is left, it goes back to the connection
+	input.erase(0, used);
+	if (!input.empty())
+		input.swap(connection.m_pending);
+	return keep && !closed;
+}
+
+bool Server::answer(Worker& worker, std::string_view frames, size_t& used)
+{
+	static const std::pmr::vector<Token> no_tokens;
+
+	auto& tokenizer = worker.m_tokenizer;
+
+	while (used < frames.size())
+	{
+		protocol::Request request;
+		bool malformed;
+
+		auto size = protocol::read_request(frames.substr(used), request, malformed);
+		if (size == protocol::broken_stream)
+		{
+			protocol::write_response(worker.m_output, 0, protocol::Status::bad_request, no_tokens);
+			return false;
+		}
+		if (size == 0)
+			return true;
+		used += size;
+
+		if (malformed)
+		{
+			protocol::write_response(worker.m_output, request.m_id, protocol::Status::bad_request, no_tokens);
+			continue;
+		}
+
+		TraceScope span("request");
+
+		tokenizer.reset();
+		tokenizer.feed(request.m_source);
+		tokenizer.finish();
+
+		auto start = worker.m_output.size();
+		if (request.m_op == protocol::Op::statements)
+		{
+			auto statements = split_statements(tokenizer.tokens());
+			protocol::write_response(worker.m_output, request.m_id, protocol::Status::ok, tokenizer.tokens(), &statements);
+		}
+		else
+			protocol::write_response(worker.m_output, request.m_id, protocol::Status::ok, tokenizer.tokens());
+
+		// the client couldn't read a frame that large, nor skip past it
+		if (worker.m_output.size() - start - 4 > protocol::max_frame)
+		{
+			worker.m_output.resize(start);
+			protocol::write_response(worker.m_output, request.m_id, protocol::Status::bad_request, no_tokens);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,130 @@
+#include "string_literal.hpp"
+
+#include <cstring>
+
+namespace
+{
+	constexpr std::array<char, 256> make_escape_table()
+	{
+		std::array<char, 256> table{};
+
+		table['n']	= '\n';
+		table['t']	= '\t';
+		table['v']	= '\v';
+		table['a']	= '\a';
+		table['b']	= '\b';
+		table['f']	= '\f';
+		table['r']	= '\r';
+		table['\\']	= '\\';
+		table['"']	= '"';
+
+		return table;
+	}
+
+	// the letter of the escape sequence for a character, 0 if it is written as it is
+	constexpr std::array<char, 256> make_escape_letters()
+	{
+		auto table = make_escape_table();
+
+		std::array<char, 256> letters{};
+		for (size_t letter = 0; letter < table.size(); ++letter)
+			if (table[letter])
+				letters[static_cast<unsigned char>(table[letter])] = char(letter);
+
+		return letters;
+	}
+
+	constexpr auto escape_letters = make_escape_letters();
+}
+
+const std::array<char, 256> string_literal::escape_table = make_escape_table();
+
+void string_literal::decode(std::string_view literal, std::string& out)
+{
+	if (!literal.empty() && literal.front() == '"')
+		literal.remove_prefix(1);
+
+	// the last quote closes the literal unless an odd number of backslashes escapes it
+	if (!literal.empty() && literal.back() == '"')
+	{
+		size_t backslashes = 0;
+		while (backslashes + 1 < literal.size() && literal[literal.size() - 2 - backslashes] == '\\')
+			++backslashes;
+
+		if (backslashes % 2 == 0)
+			literal.remove_suffix(1);
+	}
+
+	out.reserve(out.size() + literal.size());
+
+	auto cur = literal.data();
+	auto end = cur + literal.size();
+
+	while (cur < end)
+	{
+		auto backslash = static_cast<const char*>(std::memchr(cur, '\\', end - cur));
+		if (!backslash)
+		{
+			out.append(cur, end);
+			break;
+		}
+
+		out.append(cur, backslash);
+		if (backslash + 1 == end)
+		{
+			out += '\\';
+			break;
+		}
+
+		auto escaped = backslash[1];
+		if (auto value = escape_table[static_cast<unsigned char>(escaped)])
+			out += value;
+		else
+		{
+			out += '\\';
+			out += escaped;
+		}
+		cur = backslash + 2;
+	}
+}
+
+bool string_literal::is_literal(std::string_view text)
+{
+	if (text.size() < 2 || text.front() != '"' || text.back() != '"')
+		return false;
+
+	for (size_t i = 1; i + 1 < text.size(); ++i)
+	{
+		if (text[i] == '"')
+			return false;
+
+		// an escape sequence may not take the closing quote
+		if (text[i] == '\\' && (i + 2 == text.size() || !escape_table[static_cast<unsigned char>(text[++i])]))
+			return false;
+	}
+	return true;
+}
+
+void string_literal::encode(std::string_view value, std::string& out)
+{
+	out.reserve(out.size() + value.size() + 2);
+	out += '"';
+
+	// runs without anything to escape are copied in bulk
+	auto run = value.data();
+	auto end = run + value.size();
+	for (auto cur = run; cur < end; ++cur)
+	{
+		auto letter = escape_letters[static_cast<unsigned char>(*cur)];
+		if (!letter)
+			continue;
+
+		out.append(run, cur);
+		out += '\\';
+		out += letter;
+		run = cur + 1;
+	}
+	out.append(run, end);
+
+	out += '"';
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "batch_expression.hpp"
+#include "evaluator.hpp"
+#include "region.hpp"
+#include "tokenizer.hpp"
+
+namespace
+{
+	struct Compiled
+	{
+		Region		m_region;
+		Tokenizer	m_tokenizer;
+		Expression	m_expression;
+
+		explicit Compiled(const std::string& source)
+		{
+			auto& tokens = m_tokenizer.tokenize(source);
+			EXPECT_FALSE(m_expression.compile(tokens.data(), tokens.data() + tokens.size(), &m_region));
+		}
+	};
+
+	struct Table
+	{
+		std::vector<int64_t>	m_i;
+		std::vector<double>		m_x;
+
+		explicit Table(size_t rows)
+		{
+			for (size_t row = 0; row < rows; ++row)
+			{
+				m_i.push_back(int64_t(row % 97) - 40);
+				m_x.push_back(double(row % 13) * 0.75 - 3);
+			}
+		}
+
+		std::vector<std::pair<std::string, BatchExpression::Type>> columns() const
+		{
+			return { { "i", BatchExpression::Type::integer }, { "x", BatchExpression::Type::floating } };
+		}
+		std::vector<const void*> data() const { return { m_i.data(), m_x.data() }; }
+	};
+
+	// evaluates every row one by one with Evaluator
+	Value expected(Evaluator& evaluator, const Expression& expression, const Table& table, size_t row)
+	{
+		Region region;
+		evaluator.assign("i", Value::integer(table.m_i[row], &region));
+		evaluator.assign("x", Value::floating(table.m_x[row]));
+
+		Value value;
+		std::string error;
+		EXPECT_TRUE(evaluator.evaluate(expression, value, error)) << error;
+		return value;
+	}
+}
+
+TEST(BatchExpression, matchesEvaluator)
+{
+	const char* sources[] =
+	{
+		"i * 3 + 7",
+		"i -1",
+		"x * x - 2.5 * i",
+		"i // 7 + i % 7",
+		"x // 0.5 + x % 0.5",
+		"i / 4",
+		"i ** 2 + x ** 2",
+		"- i + ~i",
+		"(i << 2) | (i & 12) ^ 5",
+		"i >> 1",
+		"i <= 10 && x > 0 || i == 3",
+		"!(i != 0) || i < -30",
+		"(i > 0) == (x > 0)",
+		"i + x >= 1.5",
+		"42",
+		"i",
+		"x",
+		"true",
+	};
+
+	Table table(2500);
+	Evaluator evaluator;
+
+	for (auto source : sources)
+	{
+		Compiled compiled(source);
+
+		BatchExpression batch;
+		std::string error;
+		ASSERT_TRUE(batch.compile(compiled.m_expression, table.columns(), error)) << source << ": " << error;
+
+		std::vector<uint64_t> out(table.m_i.size());
+		ASSERT_TRUE(batch.run(table.data(), table.m_i.size(), out.data(), error)) << source << ": " << error;
+
+		for (size_t row = 0; row < table.m_i.size(); ++row)
+		{
+			auto value = expected(evaluator, compiled.m_expression, table, row);
+
+			switch (batch.result_type())
+			{
+			case BatchExpression::Type::integer:
+				ASSERT_TRUE(value.is_integer()) << source;
+				ASSERT_EQ(reinterpret_cast<const int64_t*>(out.data())[row], value.as_integer()) << source << " row " << row;
+				break;
+			case BatchExpression::Type::floating:
+				ASSERT_TRUE(value.is_floating()) << source;
+				ASSERT_DOUBLE_EQ(reinterpret_cast<const double*>(out.data())[row], value.as_floating()) << source << " row " << row;
+				break;
+			case BatchExpression::Type::boolean:
+				ASSERT_TRUE(value.is_boolean()) << source;
+				ASSERT_EQ(reinterpret_cast<const uint8_t*>(out.data())[row], uint8_t(value.as_boolean())) << source << " row " << row;
+				break;
+			}
+		}
+	}
+}
+
+TEST(BatchExpression, compileErrors)
+{
+	Table table(1);
+	BatchExpression batch;
+	std::string error;
+
+	EXPECT_FALSE(batch.compile(Compiled("i + y").m_expression, table.columns(), error));
+	EXPECT_EQ(error, "unknown variable y");
+
+	EXPECT_FALSE(batch.compile(Compiled("i + \"s\"").m_expression, table.columns(), error));
+	EXPECT_FALSE(batch.compile(Compiled("x & 1").m_expression, table.columns(), error));
+	EXPECT_EQ(error, "unsupported operand for &");
+	EXPECT_FALSE(batch.compile(Compiled("(i > 0) + 1").m_expression, table.columns(), error));
+}
+
+TEST(BatchExpression, runErrors)
+{
+	Table table(2000);
+	BatchExpression batch;
+	std::string error;
+	std::vector<uint64_t> out(table.m_i.size());
+
+	ASSERT_TRUE(batch.compile(Compiled("100 // i").m_expression, table.columns(), error));
+	EXPECT_FALSE(batch.run(table.data(), table.m_i.size(), out.data(), error));
+	EXPECT_EQ(error, "division by zero or overflow");
+
+	ASSERT_TRUE(batch.compile(Compiled("i * 9223372036854775807").m_expression, table.columns(), error));
+	EXPECT_FALSE(batch.run(table.data(), table.m_i.size(), out.data(), error));
+	EXPECT_EQ(error, "integer overflow");
+
+	// rows of the zero divisor aren't there
+	ASSERT_TRUE(batch.compile(Compiled("100 // i").m_expression, table.columns(), error));
+	EXPECT_TRUE(batch.run(table.data(), 40, out.data(), error));
+	EXPECT_EQ(reinterpret_cast<const int64_t*>(out.data())[0], -3);
+}
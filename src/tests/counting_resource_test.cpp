@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "counting_resource.hpp"
+#include "tokenizer.hpp"
+
+TEST(CountingResource, countsAllocations)
+{
+	CountingResource counting;
+	{
+		std::pmr::vector<int> numbers(&counting);
+		numbers.reserve(100);
+
+		auto stats = counting.stats();
+		EXPECT_EQ(stats.m_allocations, size_t(1));
+		EXPECT_EQ(stats.m_bytes, 100 * sizeof(int));
+		EXPECT_EQ(stats.m_bytes_in_use, 100 * sizeof(int));
+	}
+
+	auto stats = counting.stats();
+	EXPECT_EQ(stats.m_deallocations, size_t(1));
+	EXPECT_EQ(stats.m_bytes_in_use, size_t(0));
+	EXPECT_EQ(stats.m_peak_bytes, 100 * sizeof(int));
+}
+
+TEST(CountingResource, perTokenizeCall)
+{
+	CountingResource counting;
+	Tokenizer tokenizer(&counting);
+
+	std::string input;
+	for (int i = 0; i < 100; ++i)
+		input += "a_rather_long_identificator_" + std::to_string(i) + " = \"a string which doesn't fit in place\";\n";
+
+	tokenizer.tokenize(input);
+	auto first = counting.stats();
+	EXPECT_GT(first.m_allocations, size_t(100));
+
+	// the second run reuses the capacity of the token vector
+	tokenizer.reset();
+	counting.reset_stats();
+	tokenizer.tokenize(input);
+	auto second = counting.stats();
+	EXPECT_GT(second.m_allocations, size_t(0));
+	EXPECT_LT(second.m_allocations, first.m_allocations);
+}
+
+TEST(CountingResource, arenaPerRequest)
+{
+	CountingResource upstream;
+	Tokenizer tokenizer;
+
+	for (int request = 0; request < 3; ++request)
+	{
+		std::pmr::monotonic_buffer_resource arena(&upstream);
+		tokenizer.reset(&arena);
+
+		auto& tokens = tokenizer.tokenize("first_long_identificator + \"some long string literal here\"");
+		ASSERT_EQ(tokens.size(), size_t(3));
+		EXPECT_EQ(tokens[0].m_value.get_allocator().resource(), &arena);
+
+		// tokens handed to a container with another resource are copied into it
+		std::pmr::vector<Token> kept;
+		tokenizer.take_finished(kept);
+		ASSERT_EQ(kept.size(), size_t(3));
+		EXPECT_EQ(kept[2].m_value.get_allocator().resource(), std::pmr::get_default_resource());
+		EXPECT_EQ(kept[2].m_value, "\"some long string literal here\"");
+
+		tokenizer.reset(std::pmr::get_default_resource());
+		arena.release();
+
+		EXPECT_EQ(upstream.stats().m_bytes_in_use, size_t(0));
+	}
+}
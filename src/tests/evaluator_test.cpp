@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "counting_resource.hpp"
+#include "evaluator.hpp"
+#include "tokenizer.hpp"
+
+namespace
+{
+	struct Session
+	{
+		Tokenizer	m_tokenizer;
+		Evaluator	m_evaluator;
+		ParseError	m_error;
+
+		explicit Session(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+			: m_evaluator(upstream)
+		{}
+
+		// printed result or "error: " with the message
+		std::string run(const std::string& line)
+		{
+			m_tokenizer.reset();
+			auto& tokens = m_tokenizer.tokenize(line);
+
+			Value result;
+			if (!m_evaluator.run(tokens.data(), tokens.data() + tokens.size(), result, m_error))
+				return "error: " + m_error.m_message;
+
+			std::ostringstream out;
+			out << result;
+			return out.str();
+		}
+	};
+}
+
+TEST(Expression, precedence)
+{
+	Session session;
+
+	EXPECT_EQ(session.run("1 + 2 * 3"), "7");
+	EXPECT_EQ(session.run("(1 + 2) * 3"), "9");
+	EXPECT_EQ(session.run("2 ** 3 ** 2"), "512");
+	EXPECT_EQ(session.run("- 2 ** 2"), "-4");
+	EXPECT_EQ(session.run("2 ** -1"), "0.5");
+	EXPECT_EQ(session.run("1 + 2 == 3 && 4 > 3"), "true");
+	EXPECT_EQ(session.run("1 | 2 ^ 3 & 6"), "1");
+	EXPECT_EQ(session.run("1 << 2 + 1"), "8");
+	EXPECT_EQ(session.run("!0 || 1 / 0"), "true");
+	EXPECT_EQ(session.run("~5"), "-6");
+}
+
+TEST(Expression, signedLiterals)
+{
+	Session session;
+
+	// tokenized as 2 and -3
+	EXPECT_EQ(session.run("2-3"), "-1");
+	EXPECT_EQ(session.run("2 -3 * 4"), "-10");
+	EXPECT_EQ(session.run("10 -3 -2"), "5");
+	EXPECT_EQ(session.run("-3"), "-3");
+	EXPECT_EQ(session.run("-(1 + 2)"), "-3");
+	EXPECT_EQ(session.run("4 -(1 + 2)"), "1");
+	EXPECT_EQ(session.run("-1.5 * 2"), "-3.0");
+}
+
+TEST(Expression, arithmetic)
+{
+	Session session;
+
+	EXPECT_EQ(session.run("7 // 2"), "3");
+	EXPECT_EQ(session.run("7 // -2"), "-4");
+	EXPECT_EQ(session.run("-7 % 3"), "2");
+	EXPECT_EQ(session.run("7 / 2"), "3.5");
+	EXPECT_EQ(session.run("7.5 // 2"), "3.0");
+	EXPECT_EQ(session.run("1 / 0"), "error: division by zero");
+	EXPECT_EQ(session.run("9223372036854775807 + 1"), "9223372036854775808.0");
+	EXPECT_EQ(session.run("281474976710656 * 2"), "562949953421312");
+	EXPECT_EQ(session.run("\"a\" + \"b\" == \"ab\""), "true");
+	EXPECT_EQ(session.run("\"abc\" < \"abd\""), "true");
+	EXPECT_EQ(session.run("\"a\" - 1"), "error: unsupported operand for -");
+	EXPECT_EQ(session.run("1 << 64"), "error: shift count out of range");
+}
+
+TEST(Expression, parseErrors)
+{
+	Session session;
+
+	EXPECT_EQ(session.run("(1 + 2"), "error: expected )");
+	EXPECT_EQ(session.m_error.m_token, 4u);
+	EXPECT_EQ(session.run("1 +"), "error: expected an expression");
+	EXPECT_EQ(session.run("1 2"), "error: unexpected 2");
+	EXPECT_EQ(session.m_error.m_token, 1u);
+	EXPECT_EQ(session.run("x"), "error: unknown variable x");
+	EXPECT_EQ(session.m_error.m_token, 1u);
+}
+
+TEST(Evaluator, variables)
+{
+	Session session;
+
+	EXPECT_EQ(session.run("x = 40"), "40");
+	EXPECT_EQ(session.run("x += 2"), "42");
+	EXPECT_EQ(session.run("name = \"a longer string value\""), "a longer string value");
+	EXPECT_EQ(session.run("name = name + \"!\""), "a longer string value!");
+	EXPECT_EQ(session.run("x * 2"), "84");
+	EXPECT_EQ(session.run("y -= 1"), "error: unknown variable y");
+	EXPECT_EQ(session.run("true = 1"), "error: can't assign to true");
+	EXPECT_EQ(session.run(""), "nil");
+}
+
+TEST(Evaluator, reusesMemory)
+{
+	CountingResource counting;
+	Session session(&counting);
+
+	session.run("s = \"a string too long to be inlined\"");
+	// enough for both generations to grow to their size
+	for (int i = 0; i < 10000; ++i)
+		session.run("t = s + s + s + s");
+	auto allocations = counting.stats().m_allocations;
+
+	// temporaries are rolled back every line and the old values of t are collected
+	for (int i = 0; i < 10000; ++i)
+		EXPECT_EQ(session.run("t = s + \"!\""), "a string too long to be inlined!");
+
+	EXPECT_EQ(counting.stats().m_allocations, allocations);
+	EXPECT_LT(session.m_evaluator.session_bytes(), 256u * 1024);
+	EXPECT_EQ(session.run("s"), "a string too long to be inlined");
+}
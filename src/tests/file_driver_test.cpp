@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "file_driver.hpp"
+
+TEST(ThreadPool, runsEveryTask)
+{
+	ThreadPool pool(4);
+	std::atomic<size_t> sum{ 0 };
+
+	for (size_t i = 1; i <= 1000; ++i)
+		pool.submit([&sum, i](size_t worker)
+		{
+			EXPECT_LT(worker, size_t(4));
+			sum += i;
+		});
+	pool.wait();
+
+	EXPECT_EQ(sum.load(), size_t(500500));
+
+	pool.submit([&sum](size_t) { sum = 0; });
+	pool.wait();
+
+	EXPECT_EQ(sum.load(), size_t(0));
+}
+
+TEST(FileDriver, deterministicOrder)
+{
+	auto dir = std::filesystem::temp_directory_path() / (
+		"cppParser_file_driver_test_" + std::to_string(::getpid()) + "_" +
+		::testing::UnitTest::GetInstance()->current_test_info()->name()
+	);
+	std::filesystem::create_directories(dir);
+
+	std::vector<std::string> paths;
+	for (int i = 0; i < 20; ++i)
+	{
+		auto path = (dir / ("file" + std::to_string(i) + ".txt")).string();
+		std::ofstream file(path);
+		// different sizes so largest-first reorders the work
+		for (int j = 0; j < (i * 7) % 13 + 1; ++j)
+			file << "x" << i << " = " << j << ";\n";
+		paths.push_back(path);
+	}
+	paths.push_back((dir / "missing.txt").string());
+
+	FileDriver driver(3);
+	auto results = driver.run(paths);
+
+	ASSERT_EQ(results.size(), paths.size());
+	for (int i = 0; i < 20; ++i)
+	{
+		EXPECT_EQ(results[i].m_path, paths[i]);
+		ASSERT_TRUE(results[i].m_ok);
+		ASSERT_EQ(results[i].m_tokens.size(), size_t(((i * 7) % 13 + 1) * 4));
+		EXPECT_EQ(std::string_view(results[i].m_tokens[0].m_value), "x" + std::to_string(i));
+	}
+	EXPECT_FALSE(results.back().m_ok);
+
+	std::filesystem::remove_all(dir);
+}
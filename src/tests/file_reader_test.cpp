@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "file_reader.hpp"
+
+namespace
+{
+	struct Files
+	{
+		std::filesystem::path		m_dir;
+		std::vector<std::string>	m_paths;
+		std::vector<std::string>	m_contents;
+
+		Files()
+		{
+			m_dir = std::filesystem::temp_directory_path() / (
+				"cppParser_file_reader_test_" + std::to_string(::getpid()) + "_" +
+				::testing::UnitTest::GetInstance()->current_test_info()->name()
+			);
+			std::filesystem::create_directories(m_dir);
+
+			// sizes around the initial buffer size and one which needs a few reads
+			const size_t sizes[] = { 0, 1, 100, 65535, 65536, 65537, 300000, 5, 4096 };
+			for (size_t i = 0; i < std::size(sizes); ++i)
+			{
+				std::string content;
+				for (size_t j = 0; j < sizes[i]; ++j)
+					content += char('a' + (i + j) % 26);
+
+				auto path = (m_dir / ("file" + std::to_string(i))).string();
+				std::ofstream(path, std::ios::binary) << content;
+
+				m_paths.push_back(path);
+				m_contents.push_back(content);
+			}
+
+			m_paths.push_back((m_dir / "missing").string());
+			m_contents.push_back("");
+		}
+		~Files()
+		{
+			std::filesystem::remove_all(m_dir);
+		}
+	};
+
+	void read_all(FileReader& reader, const Files& files)
+	{
+		for (int round = 0; round < 2; ++round)
+		{
+			reader.start(files.m_paths);
+
+			std::vector<bool> seen(files.m_paths.size(), false);
+			FileReader::File file;
+			while (reader.next(file))
+			{
+				ASSERT_LT(file.m_index, files.m_paths.size());
+				EXPECT_FALSE(seen[file.m_index]);
+				seen[file.m_index] = true;
+
+				bool missing = file.m_index + 1 == files.m_paths.size();
+				EXPECT_EQ(file.m_ok, !missing);
+				EXPECT_EQ(file.m_data, files.m_contents[file.m_index]);
+
+				reader.recycle(file);
+			}
+
+			for (auto el : seen)
+				EXPECT_TRUE(el);
+		}
+	}
+}
+
+TEST(FileReader, threadBackend)
+{
+	Files files;
+	FileReader reader(2, 2, false);
+
+	EXPECT_EQ(reader.backend(), FileReader::Backend::threads);
+	read_all(reader, files);
+}
+
+TEST(FileReader, preferredBackend)
+{
+	Files files;
+	FileReader reader(3);
+
+	// io_uring where the kernel allows it, the thread backend otherwise
+	read_all(reader, files);
+}
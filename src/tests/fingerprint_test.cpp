@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "fingerprint.hpp"
+#include "tokenizer.hpp"
+
+namespace
+{
+	std::string script(size_t lines, size_t seed, bool comments)
+	{
+		std::string source;
+		for (size_t i = 0; i < lines; ++i)
+		{
+			auto n = std::to_string((i * 7 + seed) % 101);
+			source += "value_" + n + " = (total_" + std::to_string(i) + " + " + n + ") * scale;";
+			source += comments ? "   # step " + n + "\n" : "\n";
+		}
+		return source;
+	}
+
+	Fingerprinter fingerprint(const std::string& source)
+	{
+		Fingerprinter fingerprinter;
+		Tokenizer tokenizer;
+		tokenizer.fingerprint(&fingerprinter);
+		tokenizer.tokenize(source);
+		return fingerprinter;
+	}
+
+	std::vector<uint64_t> hashes(const Fingerprinter& fingerprinter)
+	{
+		std::vector<uint64_t> result;
+		for (auto& fingerprint : fingerprinter.fingerprints())
+			result.push_back(fingerprint.m_hash);
+		return result;
+	}
+}
+
+TEST(Fingerprinter, ignoresSpacingAndCommentaries)
+{
+	auto plain = fingerprint(script(50, 0, false));
+	auto commented = fingerprint(script(50, 0, true));
+
+	EXPECT_EQ(plain.token_count(), commented.token_count());
+	EXPECT_EQ(plain.digest(), commented.digest());
+	EXPECT_EQ(hashes(plain), hashes(commented));
+	EXPECT_FALSE(plain.fingerprints().empty());
+
+	EXPECT_EQ(fingerprint("a = b+c").digest(), fingerprint("a=b + c   # sum").digest());
+	EXPECT_NE(fingerprint("a = b + c").digest(), fingerprint("a = c + b").digest());
+	EXPECT_NE(fingerprint("a = \"x\"").digest(), fingerprint("a = x").digest());
+}
+
+TEST(Fingerprinter, sameWhileLexingAndAfterwards)
+{
+	auto source = script(200, 3, true);
+
+	Tokenizer whole;
+	Fingerprinter after;
+	for (auto& token : whole.tokenize(source))
+		after.add(token);
+	after.finish();
+
+	// handing tokens out on the way doesn't skip or repeat any
+	Fingerprinter lexing;
+	Tokenizer parts;
+	parts.fingerprint(&lexing);
+
+	std::pmr::vector<Token> taken;
+	std::string_view rest = source;
+	while (!rest.empty())
+	{
+		rest.remove_prefix(parts.tokenize_some(rest, 37));
+		parts.take_finished(taken);
+		taken.clear();
+	}
+	parts.finish();
+
+	EXPECT_EQ(lexing.token_count(), after.token_count());
+	EXPECT_EQ(lexing.digest(), after.digest());
+	EXPECT_EQ(hashes(lexing), hashes(after));
+
+	parts.reset();
+	EXPECT_EQ(lexing.token_count(), 0u);
+	EXPECT_TRUE(lexing.fingerprints().empty());
+}
+
+TEST(Fingerprinter, shortStreams)
+{
+	auto one = fingerprint("x");
+	ASSERT_EQ(one.fingerprints().size(), 1u);
+	EXPECT_EQ(hashes(one), hashes(fingerprint("x # alone")));
+	EXPECT_NE(hashes(one), hashes(fingerprint("y")));
+
+	EXPECT_TRUE(fingerprint("# nothing else").fingerprints().empty());
+}
+
+TEST(CloneIndex, findsClones)
+{
+	auto original = script(100, 0, false);
+
+	// one line changed in the middle
+	auto edited = original;
+	auto line = edited.find("value_", edited.size() / 2);
+	edited.replace(line, 5, "other");
+
+	CloneIndex index;
+	EXPECT_TRUE(index.add(fingerprint(original)).empty());
+	EXPECT_TRUE(index.add(fingerprint(script(100, 50, false))).empty());
+
+	auto copies = index.add(fingerprint(script(100, 0, true)));
+	ASSERT_EQ(copies.size(), 1u);
+	EXPECT_EQ(copies[0].m_document, 0u);
+	EXPECT_TRUE(copies[0].m_exact);
+
+	auto near = index.add(fingerprint(edited), 0.5);
+	ASSERT_EQ(near.size(), 2u);
+	EXPECT_FALSE(near[0].m_exact);
+	EXPECT_GT(near[0].m_similarity, 0.8);
+	EXPECT_LT(near[0].m_similarity, 1.0);
+	EXPECT_EQ(near[0].m_document, 0u);
+	EXPECT_EQ(near[1].m_document, 2u);
+
+	EXPECT_EQ(index.size(), 4u);
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <new>
+#include <string>
+
+#include "parallel_parse.hpp"
+#include "tokenizer.hpp"
+
+namespace
+{
+	// a stand-in statement parser: collects the identificators of a statement into its arena
+	struct Names
+	{
+		std::pmr::vector<std::string_view>* m_names = nullptr;
+	};
+
+	std::optional<ParseError> parse_names(
+		const Token* first, const Token* last,
+		std::pmr::memory_resource* arena, Names& node)
+	{
+		using Vector = std::pmr::vector<std::string_view>;
+		node.m_names = new (arena->allocate(sizeof(Vector), alignof(Vector))) Vector(arena);
+
+		for (auto it = first; it != last; ++it)
+		{
+			if (it->m_type == Token::Type::invalid)
+				return ParseError{ 0, size_t(it - first), "invalid token " + std::string(it->m_value) };
+			if (it->m_type == Token::Type::identificator)
+				node.m_names->push_back(it->m_value);
+		}
+		return std::nullopt;
+	}
+}
+
+TEST(SplitStatements, depthZeroOnly)
+{
+	Tokenizer tokenizer;
+	auto& tokens = tokenizer.tokenize("a = 1; f(b; c); ; {d;} e");
+
+	auto ranges = split_statements(tokens);
+
+	ASSERT_EQ(ranges.size(), size_t(3));
+	EXPECT_EQ(ranges[0].m_begin, size_t(0));
+	EXPECT_EQ(ranges[0].m_end, size_t(3));
+	EXPECT_EQ(ranges[1].m_begin, size_t(4));
+	EXPECT_EQ(ranges[1].m_end, size_t(10));
+	EXPECT_EQ(ranges[2].m_begin, size_t(12));
+	EXPECT_EQ(ranges[2].m_end, size_t(17));
+}
+
+TEST(ParallelParse, matchesSequential)
+{
+	std::string input;
+	for (int i = 0; i < 3000; ++i)
+	{
+		input += "x" + std::to_string(i) + " = f(y; z" + std::to_string(i) + ");";
+		if (i % 500 == 7)
+			input += " 3bad;";
+	}
+
+	Tokenizer tokenizer;
+	auto& tokens = tokenizer.tokenize(input);
+
+	auto sequential = parallel_parse<Names>(tokens, parse_names);
+
+	ThreadPool pool(4);
+	auto parallel = parallel_parse<Names>(tokens, parse_names, &pool);
+
+	ASSERT_EQ(parallel.m_statements.size(), sequential.m_statements.size());
+	for (size_t i = 0; i < parallel.m_statements.size(); ++i)
+		EXPECT_EQ(*parallel.m_statements[i].m_names, *sequential.m_statements[i].m_names);
+
+	ASSERT_EQ(parallel.m_errors.size(), size_t(6));
+	ASSERT_EQ(parallel.m_errors.size(), sequential.m_errors.size());
+	for (size_t i = 0; i < parallel.m_errors.size(); ++i)
+	{
+		EXPECT_EQ(parallel.m_errors[i].m_statement, sequential.m_errors[i].m_statement);
+		EXPECT_EQ(parallel.m_errors[i].m_token, sequential.m_errors[i].m_token);
+		EXPECT_EQ(tokens[parallel.m_errors[i].m_token].m_value, "3bad");
+	}
+}
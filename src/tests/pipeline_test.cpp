@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "pipeline.hpp"
+
+TEST(SpscRing, fifoOrder)
+{
+	SpscRing<int> ring(3);
+
+	ASSERT_EQ(ring.capacity(), size_t(4));
+
+	for (int i = 0; i < 4; ++i)
+		EXPECT_TRUE(ring.try_push(int(i)));
+	EXPECT_FALSE(ring.try_push(4));
+
+	for (int i = 0; i < 4; ++i)
+	{
+		auto value = ring.try_pop();
+		ASSERT_TRUE(value.has_value());
+		EXPECT_EQ(*value, i);
+	}
+	EXPECT_FALSE(ring.try_pop().has_value());
+}
+
+TEST(SpscRing, twoThreads)
+{
+	SpscRing<size_t> ring(8);
+	const size_t count = 100000;
+
+	std::thread producer([&]
+	{
+		for (size_t i = 0; i < count; ++i)
+			while (!ring.try_push(size_t(i)))
+				std::this_thread::yield();
+	});
+
+	size_t expected = 0;
+	while (expected < count)
+	{
+		if (auto value = ring.try_pop())
+		{
+			ASSERT_EQ(*value, expected);
+			++expected;
+		}
+		else
+			std::this_thread::yield();
+	}
+
+	producer.join();
+}
+
+TEST(TokenPipeline, sameAsSerial)
+{
+	std::string input;
+	for (int i = 0; i < 2000; ++i)
+		input += u8"имя_" + std::to_string(i) + " = (" + std::to_string(i) + " ** 2) // 3; \"str\\n ing\" # note\n";
+
+	Tokenizer tokenizer;
+	auto& expected = tokenizer.tokenize(input);
+
+	// small chunks so tokens get split between feeds
+	TokenPipeline pipeline(100, 4, 37);
+	pipeline.start(input);
+
+	std::vector<Token> tokens;
+	TokenPipeline::Batch batch;
+	while (pipeline.pop(batch))
+	{
+		EXPECT_LE(batch.size(), size_t(100));
+		tokens.insert(tokens.end(), batch.begin(), batch.end());
+	}
+
+	ASSERT_EQ(tokens.size(), expected.size());
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		EXPECT_EQ(tokens[i].m_type, expected[i].m_type);
+		EXPECT_EQ(tokens[i].m_value, expected[i].m_value);
+		EXPECT_EQ(tokens[i].m_line, expected[i].m_line);
+		EXPECT_EQ(tokens[i].m_col, expected[i].m_col);
+	}
+}
+
+TEST(TokenPipeline, emptyInput)
+{
+	TokenPipeline pipeline;
+	pipeline.start("");
+
+	TokenPipeline::Batch batch;
+	EXPECT_FALSE(pipeline.pop(batch));
+}
+
+TEST(TokenPipeline, abandonedConsumer)
+{
+	std::string input;
+	for (int i = 0; i < 20000; ++i)
+		input += "value_" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+
+	TokenPipeline::Batch batch;
+	{
+		// the ring fills up long before the input ends
+		TokenPipeline pipeline(10, 2, 64);
+		pipeline.start(input);
+		ASSERT_TRUE(pipeline.pop(batch));
+	}
+
+	// a restart gives up the previous input and begins the new one
+	TokenPipeline pipeline(10, 2, 64);
+	pipeline.start(input);
+	ASSERT_TRUE(pipeline.pop(batch));
+	pipeline.start("x");
+
+	std::vector<Token> tokens;
+	while (pipeline.pop(batch))
+		tokens.insert(tokens.end(), batch.begin(), batch.end());
+
+	ASSERT_EQ(tokens.size(), size_t(1));
+	EXPECT_EQ(tokens[0].m_value, "x");
+}
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "client.hpp"
+#include "server.hpp"
+
+namespace
+{
+	struct RunningServer
+	{
+		std::string	m_path;
+		Server		m_server;
+		std::thread	m_thread;
+
+		RunningServer()
+			:	m_path((std::filesystem::temp_directory_path() / ("cppParser_server_test_" + std::to_string(::getpid()))).string()),
+				m_server(m_path, 2)
+		{
+			EXPECT_TRUE(m_server.listen());
+			m_thread = std::thread([this] { m_server.run(); });
+		}
+		~RunningServer()
+		{
+			m_server.stop();
+			m_thread.join();
+		}
+	};
+
+	std::pmr::vector<Token> tokenize(std::string_view source)
+	{
+		Tokenizer tokenizer;
+		tokenizer.feed(source);
+		tokenizer.finish();
+		return tokenizer.tokens();
+	}
+
+	void expect_equal(const std::pmr::vector<Token>& actual, const std::pmr::vector<Token>& expected)
+	{
+		ASSERT_EQ(actual.size(), expected.size());
+		for (size_t i = 0; i < actual.size(); ++i)
+		{
+			EXPECT_EQ(actual[i].m_type, expected[i].m_type);
+			EXPECT_EQ(actual[i].m_value, expected[i].m_value);
+			EXPECT_EQ(actual[i].m_line, expected[i].m_line);
+			EXPECT_EQ(actual[i].m_col, expected[i].m_col);
+			EXPECT_EQ(actual[i].m_has_escapes, expected[i].m_has_escapes);
+		}
+	}
+}
+
+TEST(Protocol, roundTrip)
+{
+	std::string frames;
+	auto tokens = tokenize("a = \"x\\ty\"; b += 12.5 # note\n");
+	std::vector<StatementRange> statements{ { 0, 4 }, { 4, 8 } };
+
+	protocol::write_response(frames, 7, protocol::Status::ok, tokens, &statements);
+	protocol::write_request(frames, { 300, protocol::Op::tokenize, "x + y" });
+
+	protocol::Response response;
+	bool malformed = false;
+	auto size = protocol::read_response(frames, protocol::Op::statements, response, malformed);
+
+	ASSERT_NE(size, 0u);
+	EXPECT_FALSE(malformed);
+	EXPECT_EQ(response.m_id, 7u);
+	expect_equal(response.m_tokens, tokens);
+	ASSERT_EQ(response.m_statements.size(), 2u);
+	EXPECT_EQ(response.m_statements[1].m_end, 8u);
+
+	protocol::Request request;
+	EXPECT_EQ(protocol::read_request(std::string_view(frames).substr(size), request, malformed), frames.size() - size);
+	EXPECT_FALSE(malformed);
+	EXPECT_EQ(request.m_id, 300u);
+	EXPECT_EQ(request.m_source, "x + y");
+
+	// incomplete frames are left for later
+	EXPECT_EQ(protocol::read_request(std::string_view(frames).substr(size, 6), request, malformed), 0u);
+}
+
+TEST(Server, answersBatches)
+{
+	RunningServer running;
+
+	Client client;
+	ASSERT_TRUE(client.connect(running.m_path));
+
+	std::vector<std::string> sources{ "a = 1 + 2", "", "print(\"hi\") # done\nx -= 3; y", "\xff bad" };
+
+	std::vector<protocol::Request> requests;
+	for (size_t i = 0; i < sources.size(); ++i)
+		requests.push_back({ i + 10, i == 2 ? protocol::Op::statements : protocol::Op::tokenize, sources[i] });
+
+	std::vector<protocol::Response> responses;
+	for (int round = 0; round < 3; ++round)
+	{
+		ASSERT_TRUE(client.call(requests, responses));
+		ASSERT_EQ(responses.size(), sources.size());
+
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			EXPECT_EQ(responses[i].m_id, i + 10);
+			EXPECT_EQ(responses[i].m_status, protocol::Status::ok);
+			expect_equal(responses[i].m_tokens, tokenize(sources[i]));
+		}
+
+		auto statements = split_statements(tokenize(sources[2]));
+		ASSERT_EQ(responses[2].m_statements.size(), statements.size());
+		for (size_t i = 0; i < statements.size(); ++i)
+		{
+			EXPECT_EQ(responses[2].m_statements[i].m_begin, statements[i].m_begin);
+			EXPECT_EQ(responses[2].m_statements[i].m_end, statements[i].m_end);
+		}
+	}
+}
+
+TEST(Server, rejectsMalformedRequests)
+{
+	RunningServer running;
+
+	Client client;
+	ASSERT_TRUE(client.connect(running.m_path));
+
+	std::vector<protocol::Request> requests{ { 1, protocol::Op(9), "x" }, { 2, protocol::Op::tokenize, "x" } };
+	std::vector<protocol::Response> responses;
+
+	ASSERT_TRUE(client.call(requests, responses));
+	EXPECT_EQ(responses[0].m_status, protocol::Status::bad_request);
+	EXPECT_TRUE(responses[0].m_tokens.empty());
+	EXPECT_EQ(responses[1].m_status, protocol::Status::ok);
+	EXPECT_EQ(responses[1].m_tokens.size(), 1u);
+}
+
+TEST(Server, answersBatchesLargerThanTheSocketBuffers)
+{
+	// the server can't write until the client reads, sending everything first would hang
+	RunningServer running;
+
+	Client client;
+	ASSERT_TRUE(client.connect(running.m_path));
+
+	std::string source = "total = (price * quantity) // 3 + tax ** 2; name = \"item\\t1\"; # comment\n";
+	auto expected = tokenize(source);
+
+	std::vector<protocol::Request> requests;
+	for (size_t i = 0; i < 20000; ++i)
+		requests.push_back({ i, protocol::Op::tokenize, source });
+
+	std::vector<protocol::Response> responses;
+	ASSERT_TRUE(client.call(requests, responses));
+	ASSERT_EQ(responses.size(), requests.size());
+
+	for (size_t i = 0; i < responses.size(); ++i)
+	{
+		ASSERT_EQ(responses[i].m_id, i);
+		ASSERT_EQ(responses[i].m_tokens.size(), expected.size());
+	}
+	expect_equal(responses.back().m_tokens, expected);
+}
+
+TEST(Server, answersFramesArrivingInPieces)
+{
+	RunningServer running;
+
+	int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	ASSERT_GE(fd, 0);
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, running.m_path.c_str(), running.m_path.size() + 1);
+	ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+
+	std::string source;
+	for (size_t i = 0; i < 20000; ++i)
+		source += "x" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+
+	std::string frames;
+	protocol::write_request(frames, { 5, protocol::Op::tokenize, source });
+	protocol::write_request(frames, { 6, protocol::Op::tokenize, "y" });
+
+	for (size_t sent = 0; sent < frames.size(); )
+	{
+		auto count = ::send(fd, frames.data() + sent, std::min<size_t>(1000, frames.size() - sent), MSG_NOSIGNAL);
+		ASSERT_GT(count, 0);
+		sent += size_t(count);
+	}
+
+	std::string input;
+	std::vector<protocol::Response> responses(2);
+	size_t used = 0;
+	for (auto& response : responses)
+	{
+		bool malformed = false;
+		size_t size;
+		while ((size = protocol::read_response(std::string_view(input).substr(used), protocol::Op::tokenize, response, malformed)) == 0)
+		{
+			char buffer[64 * 1024];
+			auto count = ::recv(fd, buffer, sizeof(buffer), 0);
+			ASSERT_GT(count, 0);
+			input.append(buffer, size_t(count));
+		}
+		ASSERT_NE(size, protocol::broken_stream);
+		EXPECT_FALSE(malformed);
+		used += size;
+	}
+	::close(fd);
+
+	EXPECT_EQ(responses[0].m_id, 5u);
+	expect_equal(responses[0].m_tokens, tokenize(source));
+	EXPECT_EQ(responses[1].m_id, 6u);
+	EXPECT_EQ(responses[1].m_tokens.size(), 1u);
+}
+
+TEST(Server, servesMoreConnectionsThanWorkers)
+{
+	// two workers, every client stays connected between its calls
+	RunningServer running;
+
+	std::vector<Client> clients(8);
+	for (auto& client : clients)
+		ASSERT_TRUE(client.connect(running.m_path));
+
+	std::vector<protocol::Response> responses;
+	for (int round = 0; round < 3; ++round)
+		for (size_t i = 0; i < clients.size(); ++i)
+		{
+			ASSERT_TRUE(clients[i].call({ { i, protocol::Op::tokenize, "x + " + std::to_string(round) } }, responses));
+			ASSERT_EQ(responses.size(), 1u);
+			EXPECT_EQ(responses[0].m_id, i);
+			EXPECT_EQ(responses[0].m_tokens.size(), 3u);
+		}
+}
+
+TEST(Server, stopsWithOpenConnections)
+{
+	auto running = std::make_unique<RunningServer>();
+
+	Client client;
+	ASSERT_TRUE(client.connect(running->m_path));
+
+	std::vector<protocol::Response> responses;
+	ASSERT_TRUE(client.call({ { 1, protocol::Op::tokenize, "x" } }, responses));
+
+	running.reset();
+	EXPECT_FALSE(client.call({ { 2, protocol::Op::tokenize, "x" } }, responses));
+}
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "token_index.hpp"
+
+namespace
+{
+	struct Sources
+	{
+		std::filesystem::path	m_dir;
+		std::string				m_index;
+
+		Sources()
+		{
+			m_dir = std::filesystem::temp_directory_path() / (
+				"cppParser_token_index_test_" + std::to_string(::getpid()) + "_" +
+				::testing::UnitTest::GetInstance()->current_test_info()->name()
+			);
+			std::filesystem::remove_all(m_dir);
+			std::filesystem::create_directories(m_dir);
+			m_index = (m_dir / "tokens.idx").string();
+		}
+		~Sources()
+		{
+			std::filesystem::remove_all(m_dir);
+		}
+
+		std::string write(const std::string& name, const std::string& content)
+		{
+			auto path = (m_dir / name).string();
+			std::ofstream(path, std::ios::binary) << content;
+			return path;
+		}
+	};
+
+	std::vector<std::pair<size_t, size_t>> positions(const std::vector<TokenIndex::Location>& locations)
+	{
+		std::vector<std::pair<size_t, size_t>> result;
+		for (auto& location : locations)
+			result.emplace_back(location.m_line, location.m_col);
+		return result;
+	}
+}
+
+TEST(TokenIndex, findsTokens)
+{
+	Sources sources;
+	auto a = sources.write("a.txt", "x = y + x\nx += 1 #x\n");
+	auto b = sources.write("b.txt", "print(y)\n\"x\"\n");
+
+	TokenIndex index(sources.m_index);
+	EXPECT_FALSE(index.open());
+	ASSERT_TRUE(index.update({ b, a, "missing.txt" }, 2));
+
+	EXPECT_EQ(index.last_update().m_tokenized, 2u);
+	EXPECT_EQ(index.last_update().m_failed, 1u);
+	EXPECT_EQ(index.file_count(), 2u);
+
+	auto x = index.find("x");
+	ASSERT_EQ(x.size(), 3u);
+	EXPECT_EQ(x[0].m_file, a);
+	EXPECT_EQ(x[0].m_line, 1u);
+	EXPECT_EQ(x[0].m_col, 1u);
+	EXPECT_EQ(x[1].m_line, 1u);
+	EXPECT_GT(x[1].m_col, 0u);
+	EXPECT_EQ(x[2].m_line, 2u);
+
+	auto y = index.find("y");
+	ASSERT_EQ(y.size(), 2u);
+	EXPECT_EQ(y[0].m_file, a);
+	EXPECT_EQ(y[1].m_file, b);
+
+	EXPECT_EQ(index.find("\"x\"").size(), 1u);
+	EXPECT_EQ(index.find("+=").size(), 1u);
+	EXPECT_TRUE(index.find("#x").empty());
+	EXPECT_TRUE(index.find("z").empty());
+
+	TokenIndex reopened(sources.m_index);
+	ASSERT_TRUE(reopened.open());
+	EXPECT_EQ(positions(reopened.find("x")), positions(x));
+	EXPECT_EQ(reopened.term_count(), index.term_count());
+}
+
+TEST(TokenIndex, updatesChangedFiles)
+{
+	Sources sources;
+	auto a = sources.write("a.txt", "alpha = 1\n");
+	auto b = sources.write("b.txt", "beta = alpha\n");
+	auto c = sources.write("c.txt", "gamma = alpha\n");
+
+	TokenIndex index(sources.m_index);
+	ASSERT_TRUE(index.update({ a, b, c }));
+	EXPECT_EQ(index.find("alpha").size(), 3u);
+
+	sources.write("b.txt", "beta = 2\n\n  alpha alpha\n");
+	ASSERT_TRUE(index.update({ a, b }));
+
+	EXPECT_EQ(index.last_update().m_tokenized, 1u);
+	EXPECT_EQ(index.last_update().m_reused, 1u);
+
+	auto alpha = index.find("alpha");
+	ASSERT_EQ(alpha.size(), 3u);
+	EXPECT_EQ(alpha[0].m_file, a);
+	EXPECT_EQ(alpha[1].m_file, b);
+	EXPECT_EQ(alpha[1].m_line, 3u);
+	EXPECT_EQ(alpha[2].m_line, 3u);
+	EXPECT_GT(alpha[2].m_col, alpha[1].m_col);
+
+	EXPECT_TRUE(index.find("gamma").empty());
+	EXPECT_EQ(index.find("1").size(), 1u);
+	EXPECT_EQ(index.find("2").size(), 1u);
+
+	// a changed file ahead of a reused one, the merged postings keep file order
+	sources.write("a.txt", "delta = alpha\n");
+	auto terms = index.term_count();
+	ASSERT_TRUE(index.update({ a, b }));
+
+	EXPECT_EQ(index.last_update().m_tokenized, 1u);
+	EXPECT_EQ(index.last_update().m_reused, 1u);
+	EXPECT_EQ(index.term_count(), terms);
+
+	alpha = index.find("alpha");
+	ASSERT_EQ(alpha.size(), 3u);
+	EXPECT_EQ(alpha[0].m_file, a);
+	EXPECT_EQ(alpha[0].m_col, 7u);
+	EXPECT_EQ(alpha[1].m_file, b);
+	EXPECT_TRUE(index.find("1").empty());
+	EXPECT_EQ(index.find("delta").size(), 1u);
+}
+
+TEST(TokenIndex, concurrentUpdates)
+{
+	Sources sources;
+	std::vector<std::string> files;
+	for (int i = 0; i < 20; ++i)
+		files.push_back(sources.write("f" + std::to_string(i) + ".txt", "name_" + std::to_string(i) + " = shared\n"));
+
+	std::vector<std::thread> updaters;
+	for (int i = 0; i < 4; ++i)
+		updaters.emplace_back([&]
+		{
+			TokenIndex index(sources.m_index);
+			EXPECT_TRUE(index.update(files, 1));
+		});
+	for (auto& updater : updaters)
+		updater.join();
+
+	TokenIndex index(sources.m_index);
+	ASSERT_TRUE(index.open());
+	EXPECT_EQ(index.find("shared").size(), files.size());
+
+	// only the sources and the index are left, no temp files
+	size_t entries = 0;
+	for (auto& entry : std::filesystem::directory_iterator(sources.m_dir))
+		entries += entry.is_regular_file();
+	EXPECT_EQ(entries, files.size() + 1);
+}
+
+TEST(TokenIndex, rejectsDamagedFiles)
+{
+	Sources sources;
+	sources.write("tokens.idx", "cppidx01 but too short");
+
+	TokenIndex index(sources.m_index);
+	EXPECT_FALSE(index.open());
+	EXPECT_TRUE(index.find("x").empty());
+}
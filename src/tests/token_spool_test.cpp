@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "counting_resource.hpp"
+#include "token_spool.hpp"
+
+namespace
+{
+	std::string generate(size_t lines)
+	{
+		std::string source;
+		for (size_t i = 0; i < lines; ++i)
+			source += "value_" + std::to_string(i) + " = \"\xd0\xb0\xd0\xb1 long enough to be allocated\" + 3.25 * (x - 1) # line\n";
+		return source;
+	}
+
+	void expect_same_tokens(TokenSpool& spool, const std::pmr::vector<Token>& expected)
+	{
+		ASSERT_EQ(spool.size(), expected.size());
+
+		auto reader = spool.reader();
+		Token token;
+		for (auto& el : expected)
+		{
+			ASSERT_TRUE(reader.next(token));
+			EXPECT_EQ(token.m_type, el.m_type);
+			EXPECT_EQ(token.m_value, el.m_value);
+			EXPECT_EQ(token.m_line, el.m_line);
+			EXPECT_EQ(token.m_col, el.m_col);
+		}
+		EXPECT_FALSE(reader.next(token));
+		EXPECT_FALSE(reader.failed());
+	}
+}
+
+TEST(TokenSpool, staysInMemoryBelowTheLimit)
+{
+	auto source = generate(10);
+
+	Tokenizer tokenizer;
+	auto expected = tokenizer.tokenize(source);
+
+	TokenSpool spool;
+	std::istringstream input(source);
+	ASSERT_TRUE(spool.tokenize(input, tokenizer));
+
+	EXPECT_EQ(spool.spilled_bytes(), 0u);
+	expect_same_tokens(spool, expected);
+}
+
+TEST(TokenSpool, spillsPastTheLimit)
+{
+	auto source = generate(20000);
+
+	Tokenizer tokenizer;
+	auto expected = tokenizer.tokenize(source);
+
+	CountingResource counting;
+	Tokenizer spooled(&counting);
+	TokenSpool spool(64 * 1024, &counting);
+
+	// small reads split the multibyte characters between reads
+	std::istringstream input(source);
+	ASSERT_TRUE(spool.tokenize(input, spooled, 4093));
+
+	EXPECT_GT(spool.spilled_bytes(), 0u);
+	EXPECT_LE(spool.resident_bytes(), 64u * 1024);
+	// the tokens, the vector holding them and a read worth of tokens in the tokenizer
+	EXPECT_LT(counting.stats().m_peak_bytes, 512u * 1024);
+
+	expect_same_tokens(spool, expected);
+
+	spool.clear();
+	EXPECT_EQ(spool.size(), 0u);
+	EXPECT_FALSE(spool.reader().next(expected[0]));
+}
+
+TEST(TokenSpool, appendsAfterReading)
+{
+	TokenSpool spool(1);
+
+	std::pmr::vector<Token> tokens;
+	tokens.emplace_back(1, 0, Token::Type::identificator, "a");
+	tokens.emplace_back(1, 2, Token::Type::_operator, "=");
+	ASSERT_TRUE(spool.append(tokens));
+	EXPECT_TRUE(tokens.empty());
+
+	tokens.emplace_back(1, 4, Token::Type::integer, "1");
+	ASSERT_TRUE(spool.append(tokens));
+
+	std::pmr::vector<Token> expected;
+	expected.emplace_back(1, 0, Token::Type::identificator, "a");
+	expected.emplace_back(1, 2, Token::Type::_operator, "=");
+	expected.emplace_back(1, 4, Token::Type::integer, "1");
+	expect_same_tokens(spool, expected);
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "string_literal.hpp"
+#include "token_writer.hpp"
+
+namespace
+{
+	const std::vector<std::string> sources =
+	{
+		"value = (total + 12) * scale;\nnext = value // 2 ** -3;",
+		"a**=b//c<<=2; d&&=!e||~f; g = 2-3 - -4 - (5)",
+		"x = -(y) + - z -",
+		"f(a, b)[0] = { .5, 1.25, -7. };",
+		"message = \"tab\\there \\\"quoted\\\"\\n\" + \"\"",
+		"\xd0\xb8\xd0\xbc\xd1\x8f = \"\xd0\xb0\xd0\xb1\" # commentary with   spaces\n# another one\nend",
+		"if (a) { b = 1; { c = f(x, -2); } } else { i++ ; --j; }",
+		"for (i = 0; i < n; i += 1) { }",
+		"a = \"open",
+		"b = \"open \\",
+	};
+
+	std::string rewrite(const std::pmr::vector<Token>& tokens, TokenWriter::Style style)
+	{
+		std::string out;
+		TokenWriter writer(out, style);
+		EXPECT_TRUE(writer.write(tokens));
+		EXPECT_TRUE(writer.finish());
+		return out;
+	}
+
+	std::string rewrite(const std::string& source, TokenWriter::Style style)
+	{
+		Tokenizer tokenizer;
+		return rewrite(tokenizer.tokenize(source), style);
+	}
+
+	void expect_same_tokens(const std::pmr::vector<Token>& tokens, const std::pmr::vector<Token>& expected)
+	{
+		ASSERT_EQ(tokens.size(), expected.size());
+		for (size_t i = 0; i < tokens.size(); ++i)
+		{
+			EXPECT_EQ(tokens[i].m_type, expected[i].m_type) << i;
+			EXPECT_EQ(tokens[i].m_value, expected[i].m_value) << i;
+		}
+	}
+
+	void expect_round_trip(TokenWriter::Style style)
+	{
+		for (auto& source : sources)
+		{
+			SCOPED_TRACE(source);
+
+			Tokenizer tokenizer;
+			auto expected = tokenizer.tokenize(source);
+			auto text = rewrite(expected, style);
+
+			Tokenizer again;
+			expect_same_tokens(again.tokenize(text), expected);
+			EXPECT_EQ(rewrite(text, style), text);
+		}
+	}
+}
+
+TEST(TokenWriter, minifiedRoundTrips)
+{
+	expect_round_trip(TokenWriter::Style::minified);
+}
+
+TEST(TokenWriter, canonicalRoundTrips)
+{
+	expect_round_trip(TokenWriter::Style::canonical);
+}
+
+TEST(TokenWriter, minifiedKeepsOnlyNeededWhitespace)
+{
+	auto minified = TokenWriter::Style::minified;
+
+	EXPECT_EQ(rewrite("value = ( total + 12 ) * scale ;", minified), "value=(total+12)*scale;");
+	EXPECT_EQ(rewrite("a - b", minified), "a- b");
+	EXPECT_EQ(rewrite("a = -( b )", minified), "a= -(b)");
+	EXPECT_EQ(rewrite("a += - 1", minified), "a+= - 1");
+	EXPECT_EQ(rewrite("x # note\ny", minified), "x# note\ny");
+	EXPECT_EQ(rewrite("a - ", minified), "a- ");
+	EXPECT_EQ(rewrite("a -", minified), "a-");
+	EXPECT_EQ(rewrite("i++ ;", minified), "i++ ;");
+}
+
+TEST(TokenWriter, canonicalSpacesAndIndents)
+{
+	auto canonical = TokenWriter::Style::canonical;
+
+	EXPECT_EQ(rewrite("value=(total+12)*scale;", canonical), "value = (total + 12) * scale;\n");
+	EXPECT_EQ(rewrite("f(a,b)[0]= !c", canonical), "f(a, b)[0] = !c\n");
+	EXPECT_EQ(
+		rewrite("if(a){b=1;{c=f(x, -2);}}i++ ;", canonical),
+		"if(a) {\n\tb = 1;\n\t{\n\t\tc = f(x, -2);\n\t}\n}\ni++ ;\n"
+	);
+	EXPECT_EQ(rewrite("for(i=0;i<n;i+=1)", canonical), "for(i = 0; i < n; i += 1)\n");
+}
+
+TEST(TokenWriter, reEscapesStringValues)
+{
+	// a string token built from a value instead of by the tokenizer
+	std::pmr::vector<Token> tokens;
+	tokens.emplace_back(1, 1, Token::Type::identificator, "s");
+	tokens.emplace_back(1, 1, Token::Type::_operator, "=");
+	tokens.emplace_back(1, 1, Token::Type::string, "say \"hi\"\n");
+	tokens.emplace_back(1, 1, Token::Type::_operator, "+");
+	tokens.emplace_back(1, 1, Token::Type::string, "\"kept\\t\"");
+
+	auto text = rewrite(tokens, TokenWriter::Style::minified);
+	EXPECT_EQ(text, "s=\"say \\\"hi\\\"\\n\"+\"kept\\t\"");
+
+	Tokenizer tokenizer;
+	auto& again = tokenizer.tokenize(text);
+	ASSERT_EQ(again.size(), tokens.size());
+	EXPECT_EQ(again[2].m_type, Token::Type::string);
+	EXPECT_EQ(string_literal::value(again[2]), "say \"hi\"\n");
+	EXPECT_EQ(again[4].m_value, tokens[4].m_value);
+}
+
+TEST(TokenWriter, continuesTheStreamAcrossCalls)
+{
+	Tokenizer tokenizer;
+	auto& tokens = tokenizer.tokenize(sources[1]);
+
+	std::string out;
+	{
+		TokenWriter writer(out);
+		for (auto& token : tokens)
+			ASSERT_TRUE(writer.write(token));
+		ASSERT_TRUE(writer.finish());
+	}
+	EXPECT_EQ(out, rewrite(tokens, TokenWriter::Style::minified));
+}
+
+TEST(TokenWriter, writesLargeValuesToAFile)
+{
+	// values past copy_limit go out from the tokens themselves, the small buffer flushes often
+	std::string source;
+	for (size_t i = 0; i < 200; ++i)
+	{
+		source += "name_" + std::to_string(i) + " = \"" + std::string(i * 97, 'x') + "\";\n";
+		source += "# " + std::string(TokenWriter::copy_limit + i, 'c') + "\n";
+	}
+
+	Tokenizer tokenizer;
+	auto& tokens = tokenizer.tokenize(source);
+	auto expected = rewrite(tokens, TokenWriter::Style::minified);
+
+	char path[] = "/tmp/token_writer_testXXXXXX";
+	int fd = ::mkstemp(path);
+	ASSERT_GE(fd, 0);
+	::unlink(path);
+
+	size_t written = 0;
+	{
+		TokenWriter writer(fd, TokenWriter::Style::minified, TokenWriter::copy_limit);
+		ASSERT_TRUE(writer.write(tokens));
+		ASSERT_TRUE(writer.finish());
+		written = writer.written();
+	}
+	EXPECT_EQ(written, expected.size());
+
+	std::string text(expected.size() + 1, '\0');
+	auto n = ::pread(fd, text.data(), text.size(), 0);
+	::close(fd);
+	ASSERT_EQ(n, ssize_t(expected.size()));
+	text.resize(size_t(n));
+
+	EXPECT_EQ(text, expected);
+
+	Tokenizer again;
+	expect_same_tokens(again.tokenize(text), tokens);
+}
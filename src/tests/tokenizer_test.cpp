@@ -1,8 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <iostream>
 
 #include "tokenizer.hpp"
+#include "string_literal.hpp"
+#include "utf8.hpp"
 
 Tokenizer tokenizer;
 
@@ -228,35 +231,40 @@ TEST(StringCreation, escapeSequences)
 
 	ASSERT_EQ(tokens.size(), size_t(10));
 
-	EXPECT_EQ(tokens[0].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[0].m_value, std::string() + '"' + '"' + '"');
+	const char decoded[] = { '"', '\\', '\n', '\t', '\a', '\b', '\f', '\v', '\r' };
+	for (size_t i = 0; i < 9; ++i)
+	{
+		EXPECT_EQ(tokens[i].m_type, Token::Type::string);
+		EXPECT_TRUE(tokens[i].m_has_escapes);
+		EXPECT_EQ(string_literal::value(tokens[i]), std::string(1, decoded[i]));
+	}
 
-	EXPECT_EQ(tokens[1].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[1].m_value, std::string() + '"' + '\\' + '"');
+	// literals are kept as written
+	EXPECT_EQ(tokens[0].m_value, "\"\\\"\"");
+	EXPECT_EQ(tokens[1].m_value, "\"\\\\\"");
+	EXPECT_EQ(tokens[2].m_value, "\"\\n\"");
 
-	EXPECT_EQ(tokens[2].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[2].m_value, std::string() + '"' + '\n' + '"');
-
-	EXPECT_EQ(tokens[3].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[3].m_value, std::string() + '"' + '\t' + '"');
+	EXPECT_EQ(tokens[9].m_type, Token::Type::invalid);
+	EXPECT_EQ(tokens[9].m_value, "\"\\x\"");
+	EXPECT_EQ(string_literal::value(tokens[9]), "\\x");
+}
 
-	EXPECT_EQ(tokens[4].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[4].m_value, std::string() + '"' + '\a' + '"');
+TEST(StringCreation, lazyDecoding)
+{
+	tokenizer.reset();
 
-	EXPECT_EQ(tokens[5].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[5].m_value, std::string() + '"' + '\b' + '"');
+	auto& tokens = tokenizer.tokenize("\"plain text\" \"tab\\there\\\\\" \"\"");
 
-	EXPECT_EQ(tokens[6].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[6].m_value, std::string() + '"' + '\f' + '"');
+	ASSERT_EQ(tokens.size(), size_t(3));
 
-	EXPECT_EQ(tokens[7].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[7].m_value, std::string() + '"' + '\v' + '"');
+	EXPECT_FALSE(tokens[0].m_has_escapes);
+	EXPECT_EQ(string_literal::value(tokens[0]), "plain text");
 
-	EXPECT_EQ(tokens[8].m_type, Token::Type::string );
-	EXPECT_EQ(tokens[8].m_value, std::string() + '"' + '\r' + '"');
+	EXPECT_TRUE(tokens[1].m_has_escapes);
+	EXPECT_EQ(tokens[1].m_value, "\"tab\\there\\\\\"");
+	EXPECT_EQ(string_literal::value(tokens[1]), "tab\there\\");
 
-	EXPECT_EQ(tokens[9].m_type, Token::Type::invalid);
-	EXPECT_EQ(tokens[9].m_value, std::string() + '"' + '\\' + 'x' + '"');
+	EXPECT_EQ(string_literal::value(tokens[2]), "");
 }
 
 TEST(StringCreation, escapeSequenceDoesntEnd)
@@ -268,10 +276,60 @@ TEST(StringCreation, escapeSequenceDoesntEnd)
 	ASSERT_EQ(tokens.size(), size_t(1));
 
 	EXPECT_EQ(tokens[0].m_type, Token::Type::invalid);
-	EXPECT_EQ(tokens[0].m_value, "\"");
+	EXPECT_EQ(tokens[0].m_value, "\"\\");
 }
 
+TEST(StringLiteral, encodeIsTheInverseOfDecode)
+{
+	std::string value = "plain \"quoted\" back\\slash \n\t\v\a\b\f\r \xd0\xb0\xd0\xb1";
+
+	auto literal = string_literal::encode(value);
+	EXPECT_EQ(literal, "\"plain \\\"quoted\\\" back\\\\slash \\n\\t\\v\\a\\b\\f\\r \xd0\xb0\xd0\xb1\"");
+	EXPECT_EQ(string_literal::decode(literal), value);
 
+	tokenizer.reset();
+	auto& tokens = tokenizer.tokenize(literal);
+	ASSERT_EQ(tokens.size(), 1u);
+	EXPECT_EQ(tokens[0].m_type, Token::Type::string);
+	EXPECT_EQ(string_literal::value(tokens[0]), value);
+
+	EXPECT_EQ(string_literal::encode(""), "\"\"");
+}
+
+TEST(StringLiteral, isLiteral)
+{
+	EXPECT_TRUE(string_literal::is_literal("\"\""));
+	EXPECT_TRUE(string_literal::is_literal("\"a\\\"b\\\\\""));
+	EXPECT_TRUE(string_literal::is_literal("\"two\nlines\""));
+
+	EXPECT_FALSE(string_literal::is_literal("plain"));
+	EXPECT_FALSE(string_literal::is_literal("\""));
+	EXPECT_FALSE(string_literal::is_literal("\"a\"b\""));
+	EXPECT_FALSE(string_literal::is_literal("\"open\\\""));
+	EXPECT_FALSE(string_literal::is_literal("\"bad \\q\""));
+}
+
+
+
+
+TEST(CommentaryCreation, runsToTheEndOfTheLine)
+{
+	tokenizer.reset();
+
+	auto& tokens = tokenizer.tokenize("x # a b\ny");
+
+	ASSERT_EQ(tokens.size(), size_t(3));
+
+	EXPECT_EQ(tokens[0].m_type, Token::Type::identificator);
+	EXPECT_EQ(tokens[0].m_value, "x");
+
+	EXPECT_EQ(tokens[1].m_type, Token::Type::commentary);
+	EXPECT_EQ(tokens[1].m_value, "# a b");
+
+	EXPECT_EQ(tokens[2].m_type, Token::Type::identificator);
+	EXPECT_EQ(tokens[2].m_value, "y");
+	EXPECT_EQ(tokens[2].m_line, size_t(2));
+}
 
 TEST(OperatorCreation, arithmetic)
 {
@@ -593,4 +651,214 @@ TEST(ScopesInteractions, identitificators)
 
 	EXPECT_EQ(tokens[5].m_type, Token::Type::bracket);
 	EXPECT_EQ(tokens[5].m_value, ")");
-}
\ No newline at end of file
+}
+
+TEST(BracketPairing, nested)
+{
+	Tokenizer pairing;
+	pairing.track_brackets(true);
+								  // 01234567 8910 1112
+	auto& tokens = pairing.tokenize("f(a[1], {b}) ()");
+
+	ASSERT_EQ(tokens.size(), size_t(13));
+
+	EXPECT_EQ(pairing.matching_bracket(1), size_t(10));
+	EXPECT_EQ(pairing.matching_bracket(10), size_t(1));
+	EXPECT_EQ(pairing.matching_bracket(3), size_t(5));
+	EXPECT_EQ(pairing.matching_bracket(7), size_t(9));
+	EXPECT_EQ(pairing.matching_bracket(11), size_t(12));
+
+	EXPECT_EQ(pairing.matching_bracket(0), Tokenizer::npos);
+	EXPECT_EQ(pairing.matching_bracket(100), Tokenizer::npos);
+	EXPECT_TRUE(pairing.bracket_errors().empty());
+}
+
+TEST(BracketPairing, mismatched)
+{
+	Tokenizer pairing;
+	pairing.track_brackets(true);
+								  //0 1 2 3 4 5 6
+	auto& tokens = pairing.tokenize("] { ( } [ ( )");
+
+	ASSERT_EQ(tokens.size(), size_t(7));
+
+	EXPECT_EQ(pairing.matching_bracket(1), size_t(3));
+	EXPECT_EQ(pairing.matching_bracket(5), size_t(6));
+
+	ASSERT_EQ(pairing.bracket_errors().size(), size_t(3));
+	EXPECT_EQ(pairing.bracket_errors()[0], size_t(0));
+	EXPECT_EQ(pairing.bracket_errors()[1], size_t(2));
+	EXPECT_EQ(pairing.bracket_errors()[2], size_t(4));
+}
+
+
+TEST(BracketPairing, longUnbalancedRuns)
+{
+	// closing brackets of a kind which is never open must not search the open ones
+	const size_t count = 200000;
+	std::string input(count, '(');
+	input.append(count, ']');
+
+	Tokenizer pairing;
+	pairing.track_brackets(true);
+
+	auto start = std::chrono::steady_clock::now();
+	auto& tokens = pairing.tokenize(input);
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	ASSERT_EQ(tokens.size(), 2 * count);
+	EXPECT_EQ(pairing.bracket_errors().size(), 2 * count);
+	EXPECT_EQ(pairing.matching_bracket(0), Tokenizer::npos);
+	EXPECT_LT(elapsed, std::chrono::seconds(5));
+
+	// pairs after the unmatched run are still found
+	pairing.reset();
+	auto& mixed = pairing.tokenize(std::string(1000, '[') + std::string(1000, '(') + "]" + std::string(10, ')'));
+	ASSERT_EQ(mixed.size(), size_t(2011));
+	EXPECT_EQ(pairing.matching_bracket(2000), size_t(999));
+	EXPECT_EQ(pairing.matching_bracket(2001), Tokenizer::npos);
+}
+
+TEST(Utf8, identificators)
+{
+	tokenizer.reset();
+	auto& tokens = tokenizer.tokenize(u8"переменная = 变量+ x́");
+
+	ASSERT_EQ(tokens.size(), size_t(5));
+
+	EXPECT_EQ(tokens[0].m_type, Token::Type::identificator);
+	EXPECT_EQ(tokens[0].m_value, u8"переменная");
+
+	EXPECT_EQ(tokens[2].m_type, Token::Type::identificator);
+	EXPECT_EQ(tokens[2].m_value, u8"变量");
+	EXPECT_EQ(tokens[2].m_col, size_t(12));		// columns count characters, not bytes
+
+	EXPECT_EQ(tokens[4].m_type, Token::Type::identificator);
+	EXPECT_EQ(tokens[4].m_value, u8"x́");
+}
+
+TEST(Utf8, combiningMarkCantStart)
+{
+	tokenizer.reset();
+
+	auto& tokens = tokenizer.tokenize(u8"́x «x");
+
+	ASSERT_EQ(tokens.size(), size_t(2));
+
+	EXPECT_EQ(tokens[0].m_type, Token::Type::invalid);
+	EXPECT_EQ(tokens[1].m_type, Token::Type::invalid);
+}
+
+TEST(Utf8, symbolsAndPunctuationArentIdentifiers)
+{
+	// the sign, superscript and Armenian comma aren't XID, the middle dot only continues
+	for (char32_t c : { U'\u20AC', U'\u00B2', U'\u055D' })
+	{
+		EXPECT_FALSE(utf8::is_identifier_start(c)) << std::hex << uint32_t(c);
+		EXPECT_FALSE(utf8::is_identifier_continue(c)) << std::hex << uint32_t(c);
+	}
+	EXPECT_FALSE(utf8::is_identifier_start(U'\u00B7'));
+	EXPECT_TRUE(utf8::is_identifier_continue(U'\u00B7'));
+
+	tokenizer.reset();
+
+	auto& tokens = tokenizer.tokenize(u8"\u20AC a\u20AC a\u00B7b \u00B7b");
+
+	ASSERT_EQ(tokens.size(), size_t(4));
+
+	EXPECT_EQ(tokens[0].m_type, Token::Type::invalid);
+	EXPECT_EQ(tokens[1].m_type, Token::Type::invalid);
+
+	EXPECT_EQ(tokens[2].m_type, Token::Type::identificator);
+	EXPECT_EQ(tokens[2].m_value, u8"a\u00B7b");
+
+	EXPECT_EQ(tokens[3].m_type, Token::Type::invalid);
+}
+
+TEST(Utf8, strings)
+{
+	tokenizer.reset();
+
+	auto& tokens = tokenizer.tokenize(u8"\"héllo wörld 🙂\" \"bad \xC3\x28\"");
+
+	ASSERT_EQ(tokens.size(), size_t(2));
+
+	EXPECT_EQ(tokens[0].m_type, Token::Type::string);
+	EXPECT_EQ(tokens[0].m_value, u8"\"héllo wörld 🙂\"");
+
+	EXPECT_EQ(tokens[1].m_type, Token::Type::invalid);
+	EXPECT_EQ(tokens[1].m_value, "\"bad \xC3\x28\"");
+}
+
+TEST(Utf8, invalidBytes)
+{
+	tokenizer.reset();
+
+	auto& tokens = tokenizer.tokenize("a\xFF b \x80 c");
+
+	ASSERT_EQ(tokens.size(), size_t(4));
+
+	EXPECT_EQ(tokens[0].m_type, Token::Type::invalid);
+	EXPECT_EQ(tokens[0].m_value, "a\xFF");
+
+	EXPECT_EQ(tokens[1].m_type, Token::Type::identificator);
+
+	EXPECT_EQ(tokens[2].m_type, Token::Type::invalid);
+	EXPECT_EQ(tokens[2].m_value, "\x80");
+
+	EXPECT_EQ(tokens[3].m_type, Token::Type::identificator);
+}
+
+
+TEST(Resumable, everySplitPoint)
+{
+	const std::string input = u8"var_1 = -3 ** 2.5; \"a\\tb\\\\\" <<= x // имя\n(# comment\n) -- \"unterminated";
+
+	Tokenizer whole;
+	auto& expected = whole.tokenize(input);
+
+	for (size_t budget = 1; budget <= input.size(); ++budget)
+	{
+		Tokenizer parts;
+		std::string_view rest = input;
+
+		while (!rest.empty())
+			rest.remove_prefix(parts.tokenize_some(rest, budget));
+		parts.finish();
+
+		auto& tokens = parts.tokens();
+		ASSERT_EQ(tokens.size(), expected.size()) << "byte budget " << budget;
+		for (size_t i = 0; i < tokens.size(); ++i)
+		{
+			EXPECT_EQ(tokens[i].m_type, expected[i].m_type) << "byte budget " << budget;
+			EXPECT_EQ(tokens[i].m_value, expected[i].m_value) << "byte budget " << budget;
+			EXPECT_EQ(tokens[i].m_col, expected[i].m_col) << "byte budget " << budget;
+		}
+	}
+}
+
+TEST(Resumable, timeBudget)
+{
+	std::string input;
+	for (int i = 0; i < 20000; ++i)
+		input += "x" + std::to_string(i) + " += \"\\\"s\\\"\";\n";
+
+	Tokenizer whole;
+	auto& expected = whole.tokenize(input);
+
+	Tokenizer parts;
+	std::string_view rest = input;
+	size_t calls = 0;
+	while (!rest.empty())
+	{
+		auto consumed = parts.tokenize_some(rest, std::chrono::steady_clock::duration::zero());
+		ASSERT_GT(consumed, size_t(0));
+		rest.remove_prefix(consumed);
+		++calls;
+	}
+	parts.finish();
+
+	EXPECT_GT(calls, size_t(1));
+	ASSERT_EQ(parts.tokens().size(), expected.size());
+	EXPECT_EQ(parts.tokens().back().m_value, expected.back().m_value);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include "trace.hpp"
+
+TEST(LatencyHistogram, percentiles)
+{
+	LatencyHistogram histogram;
+
+	for (uint64_t i = 1; i <= 10000; ++i)
+		histogram.record(i * 1000);
+
+	EXPECT_EQ(histogram.count(), uint64_t(10000));
+	EXPECT_EQ(histogram.max(), uint64_t(10000000));
+
+	// buckets are at most 1/16 of their value wide
+	EXPECT_NEAR(double(histogram.percentile(0.5)),	5000000.0, 5000000.0 / 16);
+	EXPECT_NEAR(double(histogram.percentile(0.99)),	9900000.0, 9900000.0 / 16);
+	EXPECT_NEAR(double(histogram.percentile(0.999)),9990000.0, 9990000.0 / 16);
+	EXPECT_EQ(histogram.percentile(1.0), uint64_t(10000000));
+}
+
+TEST(LatencyHistogram, smallValuesExact)
+{
+	LatencyHistogram histogram;
+
+	for (uint64_t i = 0; i < 32; ++i)
+		histogram.record(i);
+
+	EXPECT_EQ(histogram.percentile(0), uint64_t(0));
+	EXPECT_EQ(histogram.percentile(0.5), uint64_t(16));
+	EXPECT_EQ(histogram.percentile(1.0), uint64_t(31));
+}
+
+TEST(Tracer, chromeTraceOfSeveralThreads)
+{
+	auto& tracer = Tracer::instance();
+	tracer.enable(true);
+
+	{
+		TraceScope span("test main");
+		std::thread other([] { TraceScope span("test other"); });
+		other.join();
+	}
+
+	tracer.enable(false);
+	{
+		TraceScope span("test disabled");
+	}
+
+	std::ostringstream json;
+	tracer.write_chrome_trace(json);
+
+	EXPECT_NE(json.str().find("\"name\":\"test main\",\"ph\":\"X\""), std::string::npos);
+	EXPECT_NE(json.str().find("\"name\":\"test other\""), std::string::npos);
+	EXPECT_EQ(json.str().find("test disabled"), std::string::npos);
+
+	std::ostringstream summary;
+	tracer.write_summary(summary);
+	EXPECT_NE(summary.str().find("test other: 1 spans"), std::string::npos);
+}
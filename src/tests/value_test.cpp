@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include "counting_resource.hpp"
+#include "region.hpp"
+#include "value.hpp"
+
+namespace
+{
+	std::string print(Value value)
+	{
+		std::ostringstream out;
+		out << value;
+		return out.str();
+	}
+}
+
+TEST(Value, inlineValues)
+{
+	CountingResource counting;
+
+	EXPECT_TRUE(Value().is_nil());
+	EXPECT_EQ(Value::boolean(true).type(), Value::Type::boolean);
+	EXPECT_TRUE(Value::boolean(true).as_boolean());
+	EXPECT_FALSE(Value::boolean(false).truthy());
+
+	for (int64_t integer : { int64_t(0), int64_t(-1), int64_t(42), (int64_t(1) << 47) - 1, -(int64_t(1) << 47) })
+	{
+		auto value = Value::integer(integer, &counting);
+		EXPECT_TRUE(value.is_integer());
+		EXPECT_EQ(value.as_integer(), integer);
+	}
+
+	auto text = Value::string("hello", &counting);
+	EXPECT_TRUE(text.is_string());
+	EXPECT_EQ(text.as_string(), "hello");
+	EXPECT_EQ(Value::string("", &counting).as_string(), "");
+	EXPECT_FALSE(Value::string("", &counting).truthy());
+
+	EXPECT_EQ(counting.stats().m_allocations, 0u);
+}
+
+TEST(Value, floatings)
+{
+	for (double floating : { 0.0, -0.0, 1.5, -2.25e300, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() })
+	{
+		auto value = Value::floating(floating);
+		EXPECT_TRUE(value.is_floating());
+		EXPECT_EQ(value.type(), Value::Type::floating);
+		EXPECT_EQ(value.as_floating(), floating);
+	}
+
+	// whatever NaN comes in, it can't be mistaken for a boxed value
+	auto nan = Value::floating(-std::nan(""));
+	EXPECT_TRUE(nan.is_floating());
+	EXPECT_TRUE(std::isnan(nan.as_floating()));
+
+	EXPECT_EQ(print(Value::floating(2)), "2.0");
+	EXPECT_EQ(print(Value::floating(0.1)), "0.1");
+}
+
+TEST(Value, outOfLineValues)
+{
+	Region first, second;
+
+	auto big = Value::integer(int64_t(1) << 50, &first);
+	auto text = Value::string("longer than inline", &first);
+	EXPECT_EQ(big.as_integer(), int64_t(1) << 50);
+	EXPECT_EQ(Value::integer(INT64_MIN, &first).as_integer(), INT64_MIN);
+	EXPECT_EQ(text.as_string(), "longer than inline");
+	EXPECT_GT(first.bytes_used(), 0u);
+
+	auto big_copy = big.copy_to(&second);
+	auto text_copy = text.copy_to(&second);
+	first.clear();
+
+	EXPECT_EQ(first.bytes_used(), 0u);
+	EXPECT_EQ(big_copy.as_integer(), int64_t(1) << 50);
+	EXPECT_EQ(text_copy.as_string(), "longer than inline");
+	EXPECT_EQ(print(text_copy), "longer than inline");
+}
+
+TEST(Value, concatenates)
+{
+	Region region;
+
+	EXPECT_EQ(Value::concatenate("ab", "cd", &region).as_string(), "abcd");
+	EXPECT_EQ(Value::concatenate("", "", &region).as_string(), "");
+	EXPECT_EQ(region.bytes_used(), 0u);
+
+	// the result is the only allocation
+	auto joined = Value::concatenate("longer than ", "inline", &region);
+	EXPECT_EQ(joined.as_string(), "longer than inline");
+	EXPECT_EQ(region.bytes_used(), joined.heap_size());
+}
+
+TEST(Region, rollsBackToMarks)
+{
+	CountingResource counting;
+	Region region(1024, &counting);
+
+	EXPECT_NE(region.allocate(100), nullptr);
+	auto mark = region.mark();
+
+	for (int i = 0; i < 100; ++i)
+	{
+		auto block = region.allocate(100);
+		ASSERT_NE(block, nullptr);
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % alignof(std::max_align_t), 0u);
+	}
+	auto allocations = counting.stats().m_allocations;
+	EXPECT_GT(allocations, 1u);
+
+	region.rollback(mark);
+	EXPECT_EQ(region.bytes_used(), 100u);
+
+	// the blocks are reused
+	for (int i = 0; i < 100; ++i)
+		EXPECT_NE(region.allocate(100), nullptr);
+	EXPECT_EQ(counting.stats().m_allocations, allocations);
+
+	// bigger than a block
+	auto large = region.allocate(5000, 64);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % 64, 0u);
+
+	region.clear();
+	EXPECT_EQ(region.bytes_used(), 0u);
+	EXPECT_EQ(counting.stats().m_deallocations, 0u);
+}
@@ -0,0 +1,109 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (size_t i = 0; i < threads; ++i)
+		m_queues.push_back(std::make_unique<Queue>());
+
+	for (size_t i = 0; i < threads; ++i)
+		m_workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_work_cv.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+void ThreadPool::submit(Task task)
+{
+	size_t target;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_queued;
+		++m_unfinished;
+
+		target = m_next_queue;
+		m_next_queue = (m_next_queue + 1) % m_queues.size();
+	}
+
+	auto& queue = *m_queues[target];
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	m_work_cv.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle_cv.wait(lock, [this] { return m_unfinished == 0; });
+}
+
+bool ThreadPool::pop_task(size_t worker, Task& task)
+{
+	{
+		auto& own = *m_queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.front());
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < m_queues.size(); ++i)
+	{
+		auto& victim = *m_queues[(worker + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::run(size_t worker)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_work_cv.wait(lock, [this] { return m_stop || m_queued > 0; });
+
+			if (m_queued == 0)
+				return;
+			--m_queued;
+		}
+
+		// the counter reserved one task for this worker, it is in some queue
+		// or about to be pushed there by submit()
+		Task task;
+		while (!pop_task(worker, task))
+			std::this_thread::yield();
+
+		task(worker);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_unfinished == 0)
+			m_idle_cv.notify_all();
+	}
+}
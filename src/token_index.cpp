@@ -0,0 +1,479 @@
+#include "token_index.hpp"
+#include "file_driver.hpp"
+#include "protocol.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr char		magic[8]	= { 'c', 'p', 'p', 'i', 'd', 'x', '0', '1' };
+	constexpr size_t	header_size	= 8 + 5 * 8;
+	constexpr size_t	term_size	= 8 + 8 + 4 + 4;
+
+	void put(std::string& out, uint64_t value, int bytes)
+	{
+		for (int i = 0; i < bytes; ++i)
+			out += char(value >> (8 * i));
+	}
+
+	uint64_t get(const char* data, int bytes)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; ++i)
+			value |= uint64_t(static_cast<unsigned char>(data[i])) << (8 * i);
+		return value;
+	}
+
+	// writes a file through a buffer
+	struct Output
+	{
+		static constexpr size_t flush_size = 1024 * 1024;
+
+		int			m_fd		= -1;
+		std::string	m_buffer;
+		uint64_t	m_written	= 0;
+
+		uint64_t offset() const { return m_written + m_buffer.size(); }
+
+		bool flush()
+		{
+			if (!write_at(m_written, m_buffer))
+				return false;
+
+			m_written += m_buffer.size();
+			m_buffer.clear();
+			return true;
+		}
+
+		bool write_at(uint64_t offset, std::string_view data)
+		{
+			for (size_t written = 0; written < data.size();)
+			{
+				auto count = ::pwrite(m_fd, data.data() + written, data.size() - written, off_t(offset + written));
+				if (count < 0 && errno == EINTR)
+					continue;
+				if (count <= 0)
+					return false;
+				written += size_t(count);
+			}
+			return true;
+		}
+	};
+
+	bool stat_file(const std::string& path, uint64_t& size, uint64_t& mtime)
+	{
+		struct stat info;
+		if (::stat(path.c_str(), &info) < 0)
+			return false;
+
+		size	= uint64_t(info.st_size);
+		mtime	= uint64_t(info.st_mtim.tv_sec) * 1000000000 + uint64_t(info.st_mtim.tv_nsec);
+		return true;
+	}
+}
+
+TokenIndex::TokenIndex(std::string path)
+	: m_path(std::move(path))
+{}
+
+TokenIndex::~TokenIndex()
+{
+	close();
+}
+
+bool TokenIndex::open()
+{
+	close();
+
+	m_fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (m_fd < 0)
+		return false;
+
+	struct stat info;
+	if (::fstat(m_fd, &info) < 0 || size_t(info.st_size) < header_size)
+	{
+		close();
+		return false;
+	}
+	m_size = size_t(info.st_size);
+
+	auto mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (mapped == MAP_FAILED)
+	{
+		m_size = 0;
+		close();
+		return false;
+	}
+	m_data = static_cast<const char*>(mapped);
+
+	auto files_offset	= get(m_data + 8, 8);
+	auto names_offset	= get(m_data + 16, 8);
+	auto terms_offset	= get(m_data + 24, 8);
+	auto file_count		= get(m_data + 32, 8);
+	m_term_count		= size_t(get(m_data + 40, 8));
+
+	if (	std::memcmp(m_data, magic, 8) != 0
+		||	files_offset > names_offset || names_offset > terms_offset || terms_offset > m_size
+		||	m_term_count > (m_size - terms_offset) / term_size)
+	{
+		close();
+		return false;
+	}
+
+	const char* cur = m_data + files_offset;
+	const char* end = m_data + names_offset;
+	for (uint64_t i = 0; i < file_count; ++i)
+	{
+		File file;
+		uint64_t size;
+		if (!protocol::read_varint(cur, end, size) || size > uint64_t(end - cur))
+		{
+			close();
+			return false;
+		}
+		file.m_path.assign(cur, size_t(size));
+		cur += size;
+
+		if (!protocol::read_varint(cur, end, file.m_size) || !protocol::read_varint(cur, end, file.m_mtime))
+		{
+			close();
+			return false;
+		}
+		m_files.push_back(std::move(file));
+	}
+
+	m_names = m_data + names_offset;
+	m_terms = m_data + terms_offset;
+
+	for (size_t term = 0; term < m_term_count; ++term)
+	{
+		auto entry = m_terms + term * term_size;
+		if (	get(entry, 8) + get(entry + 16, 4) > terms_offset - names_offset
+			||	get(entry + 8, 8) > files_offset)
+		{
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TokenIndex::close()
+{
+	if (m_data)
+		::munmap(const_cast<char*>(m_data), m_size);
+	if (m_fd >= 0)
+		::close(m_fd);
+
+	m_fd			= -1;
+	m_data			= nullptr;
+	m_size			= 0;
+	m_names			= nullptr;
+	m_terms			= nullptr;
+	m_term_count	= 0;
+	m_files.clear();
+}
+
+std::string_view TokenIndex::term_name(size_t term) const
+{
+	auto entry = m_terms + term * term_size;
+	return std::string_view(m_names + get(entry, 8), size_t(get(entry + 16, 4)));
+}
+
+bool TokenIndex::decode(size_t term, std::vector<Posting>& postings) const
+{
+	auto entry = m_terms + term * term_size;
+
+	const char* cur = m_data + get(entry + 8, 8);
+	const char* end = m_data + m_size;
+	auto count		= get(entry + 20, 4);
+
+	// file and line are deltas from the previous posting, the column is one when the line repeats
+	Posting posting;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t file, line, col;
+		if (	!protocol::read_varint(cur, end, file)
+			||	!protocol::read_varint(cur, end, line)
+			||	!protocol::read_varint(cur, end, col))
+			return false;
+
+		if (file != 0)
+		{
+			posting.m_file	+= uint32_t(file);
+			posting.m_line	= uint32_t(line);
+			posting.m_col	= uint32_t(col);
+		}
+		else if (line != 0)
+		{
+			posting.m_line	+= uint32_t(line);
+			posting.m_col	= uint32_t(col);
+		}
+		else
+			posting.m_col	+= uint32_t(col);
+
+		if (posting.m_file >= m_files.size())
+			return false;
+		postings.push_back(posting);
+	}
+	return true;
+}
+
+std::vector<TokenIndex::Location> TokenIndex::find(std::string_view text) const
+{
+	std::vector<Location> locations;
+
+	// terms are sorted by name
+	size_t low = 0, high = m_term_count;
+	while (low < high)
+	{
+		auto mid = low + (high - low) / 2;
+		if (term_name(mid) < text)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low == m_term_count || term_name(low) != text)
+		return locations;
+
+	std::vector<Posting> postings;
+	if (!decode(low, postings))
+		return locations;
+
+	locations.reserve(postings.size());
+	for (auto& posting : postings)
+		locations.push_back({ m_files[posting.m_file].m_path, posting.m_line, posting.m_col });
+
+	return locations;
+}
+
+bool TokenIndex::update(const std::vector<std::string>& paths, size_t threads)
+{
+	m_stats = UpdateStats();
+
+	if (!m_data)
+		open();
+
+	std::vector<File> files;
+	for (auto& path : paths)
+		files.push_back({ path });
+
+	std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.m_path < b.m_path; });
+	files.erase(
+		std::unique(files.begin(), files.end(), [](const File& a, const File& b) { return a.m_path == b.m_path; }),
+		files.end()
+	);
+
+	// old file index -> new file index or npos for files which changed or went away
+	constexpr auto npos = uint32_t(-1);
+	std::vector<uint32_t> reused(m_files.size(), npos);
+
+	std::vector<std::string> changed;
+	std::vector<uint32_t> changed_index;
+
+	for (size_t i = 0, old = 0; i < files.size(); ++i)
+	{
+		auto& file = files[i];
+		bool exists = stat_file(file.m_path, file.m_size, file.m_mtime);
+
+		while (old < m_files.size() && m_files[old].m_path < file.m_path)
+			++old;
+
+		if (	exists && old < m_files.size() && m_files[old].m_path == file.m_path
+			&&	m_files[old].m_size == file.m_size && m_files[old].m_mtime == file.m_mtime)
+		{
+			reused[old] = uint32_t(i);
+			++m_stats.m_reused;
+		}
+		else
+		{
+			changed.push_back(file.m_path);
+			changed_index.push_back(uint32_t(i));
+		}
+	}
+
+	std::vector<bool> indexed(files.size(), true);
+
+	// postings of the changed files only, the old ones are merged in term by term while writing
+	std::map<std::string, std::vector<Posting>, std::less<>> terms;
+
+	FileDriver driver(threads);
+	auto results = driver.run(changed);
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		auto file = changed_index[i];
+		if (!results[i].m_ok)
+		{
+			indexed[file] = false;
+			++m_stats.m_failed;
+			continue;
+		}
+		++m_stats.m_tokenized;
+
+		for (auto& token : results[i].m_tokens)
+		{
+			if (token.m_type == Token::Type::commentary || token.m_type == Token::Type::empty)
+				continue;
+
+			auto found = terms.find(std::string_view(token.m_value));
+			if (found == terms.end())
+				found = terms.emplace(std::string(token.m_value), std::vector<Posting>()).first;
+
+			found->second.push_back({ file, uint32_t(token.m_line), uint32_t(token.m_col) });
+		}
+	}
+	results.clear();
+
+	// files which couldn't be read are dropped, later files move down
+	std::vector<uint32_t> renumber(files.size());
+	std::vector<File> kept_files;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		renumber[i] = uint32_t(kept_files.size());
+		if (indexed[i])
+			kept_files.push_back(std::move(files[i]));
+	}
+
+	auto temp_path = m_path + ".XXXXXX";
+	Output out;
+	out.m_fd = ::mkstemp(temp_path.data());
+	if (out.m_fd < 0)
+		return false;
+
+	auto fail = [&]
+	{
+		::close(out.m_fd);
+		::unlink(temp_path.c_str());
+		return false;
+	};
+
+	if (::fchmod(out.m_fd, 0644) < 0)
+		return fail();
+
+	out.m_buffer.assign(header_size, '\0');
+
+	// names and term entries are small next to the postings, they wait until the postings are written
+	std::string names;
+	std::string entries;
+	size_t term_count = 0;
+
+	std::vector<Posting> postings;
+	std::vector<Posting> merged;
+
+	// both sides are sorted by name, the old terms are read straight from the mapped index
+	size_t old_term = 0;
+	auto new_term = terms.begin();
+	while (old_term < m_term_count || new_term != terms.end())
+	{
+		bool take_old = old_term < m_term_count && (new_term == terms.end() || term_name(old_term) <= new_term->first);
+		bool take_new = new_term != terms.end() && (old_term == m_term_count || new_term->first <= term_name(old_term));
+
+		std::string_view name;
+		merged.clear();
+
+		// renumbering keeps file order, old and new postings never share a file
+		if (take_old)
+		{
+			name = term_name(old_term);
+
+			postings.clear();
+			if (!decode(old_term++, postings))
+				return fail();
+
+			for (auto& posting : postings)
+				if (reused[posting.m_file] != npos)
+					merged.push_back({ renumber[reused[posting.m_file]], posting.m_line, posting.m_col });
+		}
+		if (take_new)
+		{
+			name = new_term->first;
+
+			auto middle = merged.size();
+			for (auto& posting : new_term->second)
+				merged.push_back({ renumber[posting.m_file], posting.m_line, posting.m_col });
+			std::sort(merged.begin() + middle, merged.end());
+			std::inplace_merge(merged.begin(), merged.begin() + middle, merged.end());
+
+			++new_term;
+		}
+
+		// a term seen only in files which changed or went away
+		if (merged.empty())
+			continue;
+
+		put(entries, names.size(), 8);
+		put(entries, out.offset(), 8);
+		put(entries, name.size(), 4);
+		put(entries, merged.size(), 4);
+		names += name;
+		++term_count;
+
+		Posting previous;
+		for (auto& posting : merged)
+		{
+			if (posting.m_file != previous.m_file)
+			{
+				protocol::write_varint(out.m_buffer, posting.m_file - previous.m_file);
+				protocol::write_varint(out.m_buffer, posting.m_line);
+				protocol::write_varint(out.m_buffer, posting.m_col);
+			}
+			else if (posting.m_line != previous.m_line)
+			{
+				protocol::write_varint(out.m_buffer, 0);
+				protocol::write_varint(out.m_buffer, posting.m_line - previous.m_line);
+				protocol::write_varint(out.m_buffer, posting.m_col);
+			}
+			else
+			{
+				protocol::write_varint(out.m_buffer, 0);
+				protocol::write_varint(out.m_buffer, 0);
+				protocol::write_varint(out.m_buffer, posting.m_col - previous.m_col);
+			}
+
+			previous = posting;
+		}
+
+		if (out.m_buffer.size() >= Output::flush_size && !out.flush())
+			return fail();
+	}
+
+	std::string header(magic, sizeof(magic));
+	put(header, out.offset(), 8);
+	for (auto& file : kept_files)
+	{
+		protocol::write_varint(out.m_buffer, file.m_path.size());
+		out.m_buffer += file.m_path;
+		protocol::write_varint(out.m_buffer, file.m_size);
+		protocol::write_varint(out.m_buffer, file.m_mtime);
+	}
+
+	put(header, out.offset(), 8);
+	out.m_buffer += names;
+
+	put(header, out.offset(), 8);
+	out.m_buffer += entries;
+
+	put(header, kept_files.size(), 8);
+	put(header, term_count, 8);
+
+	// the first flush wrote zeros where the header goes
+	if (!out.flush() || !out.write_at(0, header))
+		return fail();
+
+	if (::close(out.m_fd) < 0 || ::rename(temp_path.c_str(), m_path.c_str()) < 0)
+	{
+		::unlink(temp_path.c_str());
+		return false;
+	}
+
+	return open();
+}
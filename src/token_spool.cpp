@@ -0,0 +1,196 @@
+#include "token_spool.hpp"
+#include "protocol.hpp"
+
+#include <cerrno>
+#include <filesystem>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+	// values this short live inside of the token
+	const size_t inline_capacity = std::pmr::string().capacity();
+
+	size_t token_bytes(const Token& token)
+	{
+		auto capacity = token.m_value.capacity();
+		return sizeof(Token) + (capacity > inline_capacity ? capacity + 1 : 0);
+	}
+}
+
+TokenSpool::TokenSpool(size_t memory_limit, std::pmr::memory_resource* resource, std::string temp_dir)
+	: m_memory_limit(memory_limit), m_temp_dir(std::move(temp_dir)), m_resident(resource)
+{}
+
+TokenSpool::~TokenSpool()
+{
+	if (m_fd >= 0)
+		::close(m_fd);
+}
+
+bool TokenSpool::append(std::pmr::vector<Token>& tokens)
+{
+	if (m_failed)
+		return false;
+
+	for (auto& token : tokens)
+	{
+		m_resident_bytes += token_bytes(token);
+		m_resident.push_back(std::move(token));
+
+		if (m_resident_bytes > m_memory_limit && !spill())
+			return false;
+	}
+	tokens.clear();
+
+	return true;
+}
+
+bool TokenSpool::tokenize(std::istream& input, Tokenizer& tokenizer, size_t input_size)
+{
+	std::pmr::vector<Token> finished(m_resident.get_allocator());
+
+	tokenizer.reset();
+	return tokenizer.feed_stream(input, input_size, finished, [&] { return append(finished); });
+}
+
+void TokenSpool::clear()
+{
+	m_resident.clear();
+	m_resident_bytes = 0;
+	m_spilled_bytes = 0;
+	m_spilled_tokens = 0;
+
+	if (m_fd >= 0 && ::ftruncate(m_fd, 0) < 0)
+		m_failed = true;
+}
+
+bool TokenSpool::spill()
+{
+	if (m_fd < 0)
+	{
+		auto dir = m_temp_dir.empty() ? std::filesystem::temp_directory_path().string() : m_temp_dir;
+		std::string path = dir + "/cppParser_spool_XXXXXX";
+
+		m_fd = ::mkstemp(path.data());
+		if (m_fd < 0)
+		{
+			m_failed = true;
+			return false;
+		}
+		// the file goes away with the descriptor, whatever happens to the process
+		::unlink(path.c_str());
+	}
+
+	m_encoded.clear();
+	for (auto& token : m_resident)
+	{
+		if (m_encoded.empty())
+			m_encoded.append(4, '\0');
+		protocol::write_token(m_encoded, token);
+
+		if (m_encoded.size() >= chunk_size && !write_chunk())
+			return false;
+	}
+	if (!m_encoded.empty() && !write_chunk())
+		return false;
+
+	m_spilled_tokens += m_resident.size();
+	m_resident.clear();
+	m_resident_bytes = 0;
+
+	return true;
+}
+
+bool TokenSpool::write_chunk()
+{
+	// the chunk starts with its length, not counting the length itself
+	auto length = uint32_t(m_encoded.size() - 4);
+	for (int i = 0; i < 4; ++i)
+		m_encoded[i] = char(length >> (8 * i));
+
+	for (size_t written = 0; written < m_encoded.size();)
+	{
+		auto count = ::pwrite(m_fd, m_encoded.data() + written, m_encoded.size() - written, off_t(m_spilled_bytes + written));
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+		{
+			m_failed = true;
+			return false;
+		}
+		written += size_t(count);
+	}
+
+	m_spilled_bytes += m_encoded.size();
+	m_encoded.clear();
+
+	return true;
+}
+
+bool TokenSpool::Reader::next(Token& token)
+{
+	if (m_failed)
+		return false;
+
+	if (m_pos == m_chunk.size() && m_offset < m_spool->m_spilled_bytes && !read_chunk())
+		return false;
+
+	if (m_pos < m_chunk.size())
+	{
+		const char* cur = m_chunk.data() + m_pos;
+		if (!protocol::read_token(cur, m_chunk.data() + m_chunk.size(), token))
+		{
+			m_failed = true;
+			return false;
+		}
+		m_pos = size_t(cur - m_chunk.data());
+		return true;
+	}
+
+	if (m_resident < m_spool->m_resident.size())
+	{
+		token = m_spool->m_resident[m_resident++];
+		return true;
+	}
+	return false;
+}
+
+bool TokenSpool::Reader::read_chunk()
+{
+	auto read = [this](char* data, size_t size)
+	{
+		while (size > 0)
+		{
+			auto count = ::pread(m_spool->m_fd, data, size, off_t(m_offset));
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+
+			data += count;
+			size -= size_t(count);
+			m_offset += uint64_t(count);
+		}
+		return true;
+	};
+
+	unsigned char header[4];
+	if (!read(reinterpret_cast<char*>(header), 4))
+	{
+		m_failed = true;
+		return false;
+	}
+	auto length = size_t(header[0]) | size_t(header[1]) << 8 | size_t(header[2]) << 16 | size_t(header[3]) << 24;
+
+	m_chunk.resize(length);
+	m_pos = 0;
+	if (!read(m_chunk.data(), length))
+	{
+		m_failed = true;
+		return false;
+	}
+	return true;
+}
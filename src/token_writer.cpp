@@ -0,0 +1,314 @@
+#include "token_writer.hpp"
+#include "string_literal.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <limits.h>
+#include <unistd.h>
+
+namespace
+{
+#ifdef IOV_MAX
+	constexpr size_t iov_limit = IOV_MAX;
+#else
+	constexpr size_t iov_limit = 1024;
+#endif
+
+	bool is_minus(const char* value)	{ return value[0] == '-' && value[1] == 0; }
+	bool is_open(char c)				{ return c == '(' || c == '['; }
+	bool is_close(char c)				{ return c == ')' || c == ']'; }
+}
+
+TokenWriter::TokenWriter(int fd, Style style, size_t buffer_size)
+	: m_style(style), m_fd(fd), m_buffer(std::max(buffer_size, copy_limit))
+{
+	Tokenizer rules;
+	for (size_t c = 0; c < 256; ++c)
+	{
+		m_delimiter[c]		= rules.is_delimiter(char(c));
+		m_operator_start[c]	= rules.is_operator_start(char(c));
+	}
+	m_iov.reserve(iov_limit);
+}
+
+TokenWriter::TokenWriter(std::string& out, Style style, size_t buffer_size)
+	: TokenWriter(-1, style, buffer_size)
+{
+	m_out = &out;
+}
+
+TokenWriter::~TokenWriter()
+{
+	flush();
+}
+
+bool TokenWriter::write(const Token* begin, const Token* end)
+{
+	if (m_failed)
+		return false;
+
+	for (auto token = begin; token != end; ++token)
+	{
+		if (token->m_type == Token::Type::empty || token->m_value.empty())
+			continue;
+
+		std::string_view value = token->m_value;
+		bool escaped = token->m_type == Token::Type::string && !string_literal::is_literal(value);
+		if (escaped)
+		{
+			m_escaped.clear();
+			string_literal::encode(value, m_escaped);
+			value = m_escaped;
+		}
+
+		// an operator directly after another one, an open bracket or nothing is a prefix one
+		bool unary_position =	!m_has_prev || m_prev_type == Token::Type::_operator ||
+								(m_prev_type == Token::Type::bracket && (is_open(m_prev[0]) || m_prev[0] == '{'));
+
+		separate(token->m_type, value);
+		append(value.data(), value.size());
+
+		// m_escaped is reused by the next value
+		if (escaped && m_external)
+			flush();
+
+		m_has_prev	= true;
+		m_prev_type	= token->m_type;
+		m_prev_unary= token->m_type == Token::Type::_operator && unary_position;
+		m_prev_open	= token->m_type == Token::Type::invalid && value.front() == '"';
+
+		auto size = value.size() < sizeof(m_prev) ? value.size() : 0;
+		std::memcpy(m_prev, value.data(), size);
+		m_prev[size] = 0;
+
+		if (token->m_type == Token::Type::bracket)
+		{
+			if (m_prev[0] == '{')
+				++m_depth;
+			else if (m_prev[0] == '}' && m_depth)
+				--m_depth;
+			else if (is_open(m_prev[0]))
+				++m_nesting;
+			else if (m_nesting)
+				--m_nesting;
+		}
+	}
+
+	// the caller may drop the tokens the pending values point into
+	if (m_external)
+		return flush();
+
+	return !m_failed;
+}
+
+bool TokenWriter::finish()
+{
+	if (m_has_prev)
+	{
+		// whitespace after a trailing "-" makes it an operator instead of an integer
+		bool minus = is_minus(m_prev);
+		if (m_style == Style::canonical && !(minus && m_prev_type == Token::Type::integer) && !m_prev_open)
+			append('\n');
+		else if (minus && m_prev_type == Token::Type::_operator)
+			append(' ');
+	}
+	reset();
+
+	return flush();
+}
+
+void TokenWriter::reset()
+{
+	m_has_prev	= false;
+	m_prev_type	= Token::Type::empty;
+	m_prev[0]	= 0;
+	m_prev_unary= false;
+	m_prev_open	= false;
+
+	m_depth		= 0;
+	m_nesting	= 0;
+}
+
+bool TokenWriter::minified_space(std::string_view value) const
+{
+	auto next = static_cast<unsigned char>(value.front());
+
+	switch (m_prev_type)
+	{
+	case Token::Type::string:
+	case Token::Type::bracket:
+	case Token::Type::commentary:
+		return false;
+
+	// "-" followed by whitespace is the operator, without it a negative number
+	case Token::Type::_operator:
+		return is_minus(m_prev) || m_operator_start[next];
+
+	// a lone "-" stays an integer only if a bracket or the end follows it
+	case Token::Type::integer:
+		if (is_minus(m_prev))
+			return false;
+		return !m_delimiter[next];
+
+	case Token::Type::floating:
+	case Token::Type::identificator:
+	case Token::Type::keyword:
+		return !m_delimiter[next];
+
+	default:
+		return true;
+	}
+}
+
+void TokenWriter::separate(Token::Type type, std::string_view value)
+{
+	if (!m_has_prev)
+		return;
+
+	bool space = minified_space(value);
+	if (m_style == Style::minified)
+	{
+		// a commentary runs to the end of the line
+		if (m_prev_type == Token::Type::commentary)
+			append('\n');
+		else if (space)
+			append(' ');
+		return;
+	}
+
+	enum class Gap { none, space, line };
+
+	auto prev = m_prev[0];
+	auto next = value.front();
+	bool prev_op		= m_prev_type == Token::Type::_operator;
+	bool next_op		= type == Token::Type::_operator;
+	bool prev_bracket	= m_prev_type == Token::Type::bracket;
+	bool next_bracket	= type == Token::Type::bracket;
+	bool prev_word		=	m_prev_type == Token::Type::identificator || m_prev_type == Token::Type::keyword ||
+							(prev_bracket && is_close(prev));
+
+	Gap gap = Gap::space;
+	if (m_prev_type == Token::Type::commentary)
+		gap = Gap::line;
+	else if (m_prev_type == Token::Type::integer && is_minus(m_prev))
+		gap = Gap::none;
+	else if (type == Token::Type::commentary)
+		gap = Gap::space;
+	else if (next_op && (next == ',' || next == ';') && value.size() == 1)
+		gap = Gap::none;
+	else if ((prev_op && prev == ';' && m_nesting == 0) || (prev_bracket && (prev == '{' || prev == '}')) || (next_bracket && next == '}'))
+		gap = Gap::line;
+	else if (prev_op && prev == ',')
+		gap = Gap::space;
+	else if ((next_bracket && is_close(next)) || (prev_bracket && is_open(prev)))
+		gap = Gap::none;
+	else if (next_bracket && is_open(next))
+		gap = prev_word ? Gap::none : Gap::space;
+	else if (next_op && prev_word && (value == "++" || value == "--"))
+		gap = Gap::none;
+	else if (prev_op && m_prev_unary)
+		gap = Gap::none;
+
+	if (gap == Gap::none && space)
+		gap = Gap::space;
+
+	if (gap == Gap::space)
+		append(' ');
+	else if (gap == Gap::line)
+	{
+		append('\n');
+
+		auto depth = m_depth;
+		if (next_bracket && next == '}' && depth)
+			--depth;
+		for (size_t i = 0; i < depth; ++i)
+			append('\t');
+	}
+}
+
+void TokenWriter::append(const char* data, size_t size)
+{
+	if (size >= copy_limit)
+	{
+		close_segment();
+		m_iov.push_back({ const_cast<char*>(data), size });
+		m_external = true;
+
+		// room for the segment after it
+		if (m_iov.size() + 1 >= iov_limit)
+			flush();
+		return;
+	}
+
+	if (m_buffer.size() - m_used < size)
+		flush();
+
+	std::memcpy(m_buffer.data() + m_used, data, size);
+	m_used += size;
+}
+
+void TokenWriter::append(char c)
+{
+	if (m_used == m_buffer.size())
+		flush();
+
+	m_buffer[m_used++] = c;
+}
+
+void TokenWriter::close_segment()
+{
+	if (m_used == m_segment)
+		return;
+
+	m_iov.push_back({ m_buffer.data() + m_segment, m_used - m_segment });
+	m_segment = m_used;
+}
+
+bool TokenWriter::flush()
+{
+	close_segment();
+
+	if (m_out)
+	{
+		for (auto& iov : m_iov)
+		{
+			m_out->append(static_cast<const char*>(iov.iov_base), iov.iov_len);
+			m_written += iov.iov_len;
+		}
+	}
+	else
+	{
+		size_t first = 0;
+		while (!m_failed && first < m_iov.size())
+		{
+			auto count = std::min(m_iov.size() - first, iov_limit);
+			auto n = ::writev(m_fd, m_iov.data() + first, int(count));
+			if (n < 0)
+			{
+				if (errno != EINTR)
+					m_failed = true;
+				continue;
+			}
+			m_written += size_t(n);
+
+			// skip what is written in full and trim what is written in part
+			auto done = size_t(n);
+			while (first < m_iov.size() && done >= m_iov[first].iov_len)
+				done -= m_iov[first++].iov_len;
+			if (done)
+			{
+				m_iov[first].iov_base = static_cast<char*>(m_iov[first].iov_base) + done;
+				m_iov[first].iov_len -= done;
+			}
+		}
+	}
+
+	m_iov.clear();
+	m_used		= 0;
+	m_segment	= 0;
+	m_external	= false;
+
+	return !m_failed;
+}
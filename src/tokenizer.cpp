@@ -1,6 +1,38 @@
 #include "tokenizer.hpp"
+#include "utf8.hpp"
+#include "string_literal.hpp"
 
-Tokenizer::Tokenizer()
+#include <algorithm>
+#include <new>
+
+namespace
+{
+	// character classes of the C locale, code points above ASCII are handled by utf8::
+	bool is_space(char32_t c)	{ return c == ' ' || (c >= '\t' && c <= '\r'); }
+	bool is_digit(char32_t c)	{ return c >= '0' && c <= '9'; }
+	bool is_alpha(char32_t c)	{ return (c | 0x20) >= 'a' && (c | 0x20) <= 'z'; }
+
+	bool is_identifier_start(char32_t c)
+	{
+		return c < 0x80 ? c == '_' || is_alpha(c) : utf8::is_identifier_start(c);
+	}
+	bool is_identifier_continue(char32_t c)
+	{
+		return c < 0x80 ? c == '_' || is_alpha(c) || is_digit(c) : utf8::is_identifier_continue(c);
+	}
+
+	// pmr containers never take over another allocator, so the container is recreated
+	template<typename Container>
+	void rebind(Container& container, std::pmr::memory_resource* resource)
+	{
+		container.~Container();
+		new (&container) Container(resource);
+	}
+}
+
+Tokenizer::Tokenizer(std::pmr::memory_resource* resource)
+	:	m_tokens(resource), m_bracket_stack(resource),
+		m_bracket_partner(resource), m_bracket_errors(resource)
 {
 	m_state = State::new_token;
 	m_cur_line = 1;
@@ -20,7 +52,6 @@ Tokenizer::Tokenizer()
 		"&=", "|=", "^=", "~=", "<<=", ">>=",
 		",", ";"
 	});
-	m_escape_sequence.insert({ 'n', 't', 'v', 'a', 'b', 'f', 'r', '\\', '\"' });
 	m_forbidden.insert({ '#','$', ':', '?', '@', '/', '`' });
 
 	m_brackets.insert({ '(', ')', '{', '}', '[', ']' });
@@ -63,15 +94,217 @@ void Tokenizer::state_change(State new_state)
 	}
 }
 
-const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
+void Tokenizer::reset(std::pmr::memory_resource* resource)
+{
+	reset();
+
+	rebind(m_tokens, resource);
+	rebind(m_bracket_stack, resource);
+	rebind(m_bracket_partner, resource);
+	rebind(m_bracket_errors, resource);
+}
+
+const std::pmr::vector<Token>& Tokenizer::tokenize(const std::string& str)
+{
+	feed(str);
+	finish();
+
+	return m_tokens;
+}
+
+void Tokenizer::take_finished(std::pmr::vector<Token>& out)
+{
+	if (m_tokens.empty())
+		return;
+
+	// while a token is still being built the last one has to stay with the tokenizer
+	auto finished = m_tokens.size();
+	if (m_state != State::new_token && m_state != State::end)
+		--finished;
+
+	if (m_fingerprinter)
+		fingerprint_finished(finished);
+
+	out.insert(
+		out.end(),
+		std::make_move_iterator(m_tokens.begin()),
+		std::make_move_iterator(m_tokens.begin() + finished)
+	);
+	m_tokens.erase(m_tokens.begin(), m_tokens.begin() + finished);
+	m_token_offset += finished;
+}
+
+void Tokenizer::fingerprint_finished(size_t count)
+{
+	for (auto i = m_fingerprinted - m_token_offset; i < count; ++i)
+		m_fingerprinter->add(m_tokens[i]);
+
+	m_fingerprinted = std::max(m_fingerprinted, m_token_offset + count);
+}
+
+namespace
+{
+	size_t bracket_kind(char bracket)
+	{
+		return bracket == '(' || bracket == ')' ? 0 : bracket == '{' || bracket == '}' ? 1 : 2;
+	}
+}
+
+void Tokenizer::pair_bracket(char bracket)
+{
+	auto index = m_token_offset + m_tokens.size() - 1;
+	auto kind = bracket_kind(bracket);
+
+	if (bracket == '(' || bracket == '{' || bracket == '[')
+	{
+		m_bracket_stack.emplace_back(index, bracket);
+		++m_open_brackets[kind];
+		return;
+	}
+
+	// without an open bracket of its kind the stack isn't searched, so a run
+	// of unmatched closing brackets stays linear
+	if (m_open_brackets[kind] == 0)
+	{
+		m_bracket_errors.push_back(index);
+		return;
+	}
+
+	// a closing bracket pairs with the nearest open one of its kind, open brackets
+	// skipped over on the way are left without a pair and leave the stack with it
+	auto open = bracket == ')' ? '(' : bracket == '}' ? '{' : '[';
+	auto it = std::find_if(
+		m_bracket_stack.rbegin(), m_bracket_stack.rend(),
+		[open](const auto& el) { return el.second == open; }
+	);
+
+	for (auto skipped = m_bracket_stack.rbegin(); skipped != it; ++skipped)
+	{
+		m_bracket_errors.push_back(skipped->first);
+		--m_open_brackets[bracket_kind(skipped->second)];
+	}
+	--m_open_brackets[kind];
+
+	auto open_index = it->first;
+	m_bracket_stack.erase(std::next(it).base(), m_bracket_stack.end());
+
+	if (m_bracket_partner.size() <= index)
+		m_bracket_partner.resize(index + 1, npos);
+	m_bracket_partner[open_index]	= index;
+	m_bracket_partner[index]		= open_index;
+}
+
+void Tokenizer::feed(std::string_view str)
+{
+	consume(str, str.size(), nullptr);
+}
+
+bool Tokenizer::feed_stream(
+	std::istream& input,
+	size_t chunk_size,
+	std::pmr::vector<Token>& finished,
+	const std::function<bool()>& flush
+)
+{
+	std::string buffer;
+
+	size_t kept = 0;	// bytes of a split character carried over to the next read
+	while (input)
+	{
+		buffer.resize(kept + chunk_size);
+		input.read(buffer.data() + kept, std::streamsize(chunk_size));
+		buffer.resize(kept + size_t(input.gcount()));
+
+		// don't split a character between two feeds, unless the stream ends inside of it
+		std::string_view part = buffer;
+		if (input && !buffer.empty())
+		{
+			auto last = utf8::floor_boundary(buffer, buffer.size() - 1);
+			if (last + utf8::sequence_length(buffer[last]) > buffer.size())
+				part = part.substr(0, last);
+		}
+
+		feed(part);
+		take_finished(finished);
+		if (!flush())
+			return false;
+
+		kept = buffer.size() - part.size();
+		buffer.erase(0, part.size());
+	}
+
+	finish();
+	take_finished(finished);
+
+	return flush() && !input.bad();
+}
+
+size_t Tokenizer::tokenize_some(std::string_view input, size_t byte_budget)
 {
-	auto n = str.size();
+	return consume(input, byte_budget, nullptr);
+}
 
-	for (int i = 0; i < n;)
+size_t Tokenizer::tokenize_some(std::string_view input, std::chrono::steady_clock::duration time_budget)
+{
+	auto deadline = std::chrono::steady_clock::now() + time_budget;
+	return consume(input, input.size(), &deadline);
+}
+
+size_t Tokenizer::consume(
+	std::string_view str,
+	size_t max_bytes,
+	const std::chrono::steady_clock::time_point* deadline
+)
+{
+	// looking at the clock for every character would cost more than the lexing
+	constexpr size_t clock_period = 1024;
+	// input is validated in windows, so a budgeted call doesn't scan the whole rest of it
+	constexpr size_t validation_window = 64 * 1024;
+
+	if (m_state == State::end)
+		m_state = State::new_token;
+
+	auto n		= str.size();
+	auto limit	= std::min(n, max_bytes);
+
+	size_t validated_end = 0;	// [.., validated_end) is validated
+	size_t first_invalid = 0;	// first invalid byte there or validated_end
+	size_t steps = 0;
+
+	size_t i = 0;
+	while (i < limit)
 	{
+		// every piece of state lives in the members, so stopping here is always resumable
+		if (deadline && i > 0 && ++steps % clock_period == 0 && std::chrono::steady_clock::now() >= *deadline)
+			break;
+
 		auto cur_char = str[i];
 
-		if (isspace(cur_char))
+		// ASCII goes straight through, other characters are decoded as a whole,
+		// operators and delimiters are all ASCII so the switch can keep using cur_char
+		char32_t	code = static_cast<unsigned char>(cur_char);
+		size_t		len  = 1;
+		if (code >= 0x80)
+		{
+			if (i >= validated_end)
+			{
+				validated_end = utf8::floor_boundary(str, std::min(n, i + validation_window));
+				first_invalid = i + utf8::validate(str.data() + i, validated_end - i);
+			}
+
+			if (i < first_invalid)
+			{
+				len = utf8::sequence_length(code);
+				code = utf8::decode(str.data() + i, len);
+			}
+			else
+			{
+				code = utf8::invalid;
+				first_invalid = i + 1 + utf8::validate(str.data() + i + 1, validated_end - i - 1);
+			}
+		}
+
+		if (is_space(code))
 		{
 			if (cur_char == '\n')
 			{
@@ -82,7 +315,8 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 					m_state = State::new_token;
 			}
 
-			if (m_state == State::string)
+			// a commentary runs to the end of the line
+			if (m_state == State::string || m_state == State::commentary)
 				last_token().m_value += cur_char;
 			else if (m_state == State::string_escape)
 				state_change(State::invalid);
@@ -107,10 +341,10 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 			push_token({ m_cur_line, m_cur_col });
 
 			// integer literals
-			if (cur_char == '-' || isdigit(cur_char))
+			if (cur_char == '-' || is_digit(code))
 				state_change(State::integer);
 			// identificators
-			else if (cur_char == '_' || isalpha(cur_char))
+			else if (is_identifier_start(code))
 				state_change(State::identificator);
 			// floating pointer numbers
 			else if (cur_char == '.')
@@ -129,6 +363,9 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 			{
 				last_token().m_type = Token::Type::bracket;
 				state_change(State::new_token);
+
+				if (m_track_brackets)
+					pair_bracket(cur_char);
 			}
 			else
 				state_change(State::invalid);
@@ -142,7 +379,7 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 				state_change(State::new_token);
 				continue;
 			}
-			else if (!isalnum(cur_char) && cur_char != '_')
+			else if (!is_identifier_continue(code))
 				state_change(State::invalid);
 			break;
 		}
@@ -152,35 +389,21 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 				state_change(State::new_token);
 			else if (cur_char == '\\')
 			{
+				last_token().m_has_escapes = true;
 				state_change(State::string_escape);
-				++i;
-				continue;
 			}
+			else if (code == utf8::invalid)
+				last_token().m_type = Token::Type::invalid;
 
 			break;
 		}
 		case State::string_escape:
 		{
-			if      (cur_char == 'n')  last_token().m_value += '\n';
-			else if (cur_char == 't')  last_token().m_value += '\t';
-			else if (cur_char == 'a')  last_token().m_value += '\a';
-			else if (cur_char == 'b')  last_token().m_value += '\b';
-			else if (cur_char == 'f')  last_token().m_value += '\f';
-			else if (cur_char == 'v')  last_token().m_value += '\v';
-			else if (cur_char == 'r')  last_token().m_value += '\r';
-			else if (cur_char == '"')  last_token().m_value += '\"';
-			else if (cur_char == '\\') last_token().m_value += '\\';
-			else
-			{
+			// the literal is kept as written, string_literal::decode() produces its value
+			if (string_literal::escape_table[static_cast<unsigned char>(cur_char)] == 0)
 				last_token().m_type = Token::Type::invalid;
-				last_token().m_value += '\\';
-				last_token().m_value += cur_char;
-			}
 
 			m_state = State::string;
-			++i;
-			continue;
-
 			break;
 		}
 		case State::integer:
@@ -199,7 +422,7 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 			}
 			else if (cur_char == '.')
 				state_change(State::floating);
-			else if (!isdigit(cur_char))
+			else if (!is_digit(code))
 				state_change(State::invalid);
 			break;
 		}
@@ -210,7 +433,7 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 				state_change(State::new_token);
 				continue;
 			}
-			else if (!isdigit(cur_char))
+			else if (!is_digit(code))
 				state_change(State::invalid);
 			break;
 		}
@@ -225,12 +448,15 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 		}
 		case State::_operator:
 		{
-			auto cur_pot_op = last_token().m_value;
+			std::string_view cur_pot_op = last_token().m_value;
 			// if cur char is in the list of operator's characters 
 			// then we will check is that sequence form an valid operator
 			if (m_pot_op.count(cur_char))
 			{
-				if (m_actual_ops.count(cur_pot_op + cur_char) == 0)
+				std::string candidate(cur_pot_op);
+				candidate += cur_char;
+
+				if (m_actual_ops.count(candidate) == 0)
 					state_change(State::_operator_invalid);
 			}
 			else
@@ -263,14 +489,31 @@ const std::vector<Token>& Tokenizer::tokenize(const std::string& str)
 
 		}
 
-		++i;
-		last_token().m_value += cur_char;
+		last_token().m_value.append(str.data() + i, len);
+		i += len;
 	}
 
+	return i;
+}
+
+void Tokenizer::finish()
+{
 	if (m_state == State::string || m_state == State::string_escape)
 		last_token().m_type = Token::Type::invalid;
-	if (m_state == State::_operator && m_actual_ops.count(last_token().m_value) == 0)
+	if (m_state == State::_operator && m_actual_ops.count(std::string_view(last_token().m_value)) == 0)
 		last_token().m_type = Token::Type::invalid;
 
-	return m_tokens;
+	for (auto& el : m_bracket_stack)
+		m_bracket_errors.push_back(el.first);
+	m_bracket_stack.clear();
+	std::fill(std::begin(m_open_brackets), std::end(m_open_brackets), 0);
+	std::sort(m_bracket_errors.begin(), m_bracket_errors.end());
+
+	if (m_fingerprinter)
+	{
+		fingerprint_finished(m_tokens.size());
+		m_fingerprinter->finish();
+	}
+
+	m_state = State::end;
 }
\ No newline at end of file
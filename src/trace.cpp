@@ -0,0 +1,192 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+size_t LatencyHistogram::bucket_of(uint64_t value)
+{
+	// values below 2^sub_bits get a bucket each, above that the top sub_bits
+	// bits after the leading one pick the bucket within its power of two
+	if (value < (uint64_t(1) << sub_bits))
+		return size_t(value);
+
+	int exponent = 63;
+	while ((value >> exponent) == 0)
+		--exponent;
+
+	auto shift = exponent - sub_bits;
+	auto sub = (value >> shift) & ((uint64_t(1) << sub_bits) - 1);
+
+	return (size_t(shift + 1) << sub_bits) + size_t(sub);
+}
+
+uint64_t LatencyHistogram::bucket_top(size_t bucket)
+{
+	if (bucket < (size_t(1) << sub_bits))
+		return bucket;
+
+	auto shift = int(bucket >> sub_bits) - 1;
+	auto sub = uint64_t(bucket) & ((uint64_t(1) << sub_bits) - 1);
+	auto low = ((uint64_t(1) << sub_bits) | sub) << shift;
+
+	return low + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+	++m_counts[bucket_of(nanoseconds)];
+	++m_count;
+	m_max = std::max(m_max, nanoseconds);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (size_t i = 0; i < buckets; ++i)
+		m_counts[i] += other.m_counts[i];
+	m_count += other.m_count;
+	m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+	if (m_count == 0)
+		return 0;
+
+	auto rank = uint64_t(fraction * double(m_count));
+	if (rank >= m_count)
+		rank = m_count - 1;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < buckets; ++i)
+	{
+		seen += m_counts[i];
+		if (seen > rank)
+			return std::min(bucket_top(i), m_max);
+	}
+
+	return m_max;
+}
+
+
+Tracer::Tracer()
+	: m_start(std::chrono::steady_clock::now())
+{}
+
+Tracer& Tracer::instance()
+{
+	static Tracer tracer;
+	return tracer;
+}
+
+Tracer::ThreadBuffer& Tracer::local_buffer()
+{
+	// the tracer keeps a reference, so spans of finished threads still get dumped
+	thread_local std::shared_ptr<ThreadBuffer> buffer;
+
+	if (!buffer)
+	{
+		buffer = std::make_shared<ThreadBuffer>();
+		buffer->m_events.resize(ring_size);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		buffer->m_thread = m_threads.size() + 1;
+		m_threads.push_back(buffer);
+	}
+
+	return *buffer;
+}
+
+void Tracer::record(
+	const char* name,
+	std::chrono::steady_clock::time_point begin,
+	std::chrono::steady_clock::time_point end
+)
+{
+	auto& buffer = local_buffer();
+
+	auto& event = buffer.m_events[buffer.m_written % ring_size];
+	event.m_name		= name;
+	event.m_begin		= uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(begin - m_start).count());
+	event.m_duration	= uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+	++buffer.m_written;
+
+	auto it = std::find_if(
+		buffer.m_histograms.begin(), buffer.m_histograms.end(),
+		[name](const auto& el) { return el.first == name; }
+	);
+	if (it == buffer.m_histograms.end())
+	{
+		buffer.m_histograms.emplace_back(name, LatencyHistogram());
+		it = std::prev(buffer.m_histograms.end());
+	}
+	it->second.record(event.m_duration);
+}
+
+void Tracer::write_chrome_trace(std::ostream& out) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto write_time = [&out](uint64_t nanoseconds)
+	{
+		// microseconds with the nanoseconds as fraction
+		out << nanoseconds / 1000 << '.';
+		auto fraction = nanoseconds % 1000;
+		out << char('0' + fraction / 100) << char('0' + fraction / 10 % 10) << char('0' + fraction % 10);
+	};
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	bool first = true;
+	for (auto& buffer : m_threads)
+	{
+		auto count = std::min(buffer->m_written, ring_size);
+		for (auto i = buffer->m_written - count; i < buffer->m_written; ++i)
+		{
+			auto& event = buffer->m_events[i % ring_size];
+
+			out << (first ? "\n" : ",\n");
+			first = false;
+
+			out << "{\"name\":\"" << event.m_name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->m_thread << ",\"ts\":";
+			write_time(event.m_begin);
+			out << ",\"dur\":";
+			write_time(event.m_duration);
+			out << '}';
+		}
+	}
+
+	out << "\n]}\n";
+}
+
+std::vector<std::pair<const char*, LatencyHistogram>> Tracer::histograms() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<std::pair<const char*, LatencyHistogram>> merged;
+	for (auto& buffer : m_threads)
+		for (auto& [name, histogram] : buffer->m_histograms)
+		{
+			auto it = std::find_if(
+				merged.begin(), merged.end(),
+				[name = name](const auto& el) { return std::strcmp(el.first, name) == 0; }
+			);
+			if (it == merged.end())
+				merged.emplace_back(name, histogram);
+			else
+				it->second.merge(histogram);
+		}
+
+	return merged;
+}
+
+void Tracer::write_summary(std::ostream& out) const
+{
+	auto micros = [](uint64_t nanoseconds) { return double(nanoseconds) / 1000; };
+
+	for (auto& [name, histogram] : histograms())
+		out << name << ": " << histogram.count() << " spans, "
+			<< "p50 "	<< micros(histogram.percentile(0.5))	<< " us, "
+			<< "p99 "	<< micros(histogram.percentile(0.99))	<< " us, "
+			<< "p999 "	<< micros(histogram.percentile(0.999))	<< " us, "
+			<< "max "	<< micros(histogram.max())				<< " us\n";
+}
@@ -0,0 +1,127 @@
+#include "utf8.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define UTF8_SSE2
+#endif
+
+namespace
+{
+	// length of the valid sequence at data or 0
+	size_t check_sequence(const unsigned char* data, size_t size)
+	{
+		auto lead = data[0];
+		size_t length;
+		unsigned char low = 0x80, high = 0xBF;	// allowed range of the second byte
+
+		if (lead < 0xC2)
+			return 0;
+		else if (lead < 0xE0)
+			length = 2;
+		else if (lead < 0xF0)
+		{
+			length = 3;
+			if (lead == 0xE0) low = 0xA0;		// overlong
+			if (lead == 0xED) high = 0x9F;		// surrogates
+		}
+		else if (lead < 0xF5)
+		{
+			length = 4;
+			if (lead == 0xF0) low = 0x90;		// overlong
+			if (lead == 0xF4) high = 0x8F;		// above U+10FFFF
+		}
+		else
+			return 0;
+
+		if (size < length || data[1] < low || data[1] > high)
+			return 0;
+		for (size_t i = 2; i < length; ++i)
+			if (!utf8::is_continuation(data[i]))
+				return 0;
+
+		return length;
+	}
+
+	struct Range
+	{
+		char32_t first, last;
+	};
+
+#include "utf8_xid.inc"
+
+	template<size_t N>
+	bool in_ranges(const Range (&ranges)[N], char32_t code_point)
+	{
+		auto it = std::upper_bound(
+			std::begin(ranges), std::end(ranges), code_point,
+			[](char32_t value, const Range& range) { return value < range.first; }
+		);
+		return it != std::begin(ranges) && code_point <= std::prev(it)->last;
+	}
+}
+
+size_t utf8::validate(const char* data, size_t size)
+{
+	auto bytes = reinterpret_cast<const unsigned char*>(data);
+	size_t i = 0;
+
+	while (i < size)
+	{
+#ifdef UTF8_SSE2
+		while (i + 16 <= size)
+		{
+			auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+			if (_mm_movemask_epi8(block) != 0)
+				break;
+			i += 16;
+		}
+		if (i == size)
+			break;
+#endif
+		if (bytes[i] < 0x80)
+		{
+			++i;
+			continue;
+		}
+
+		auto length = check_sequence(bytes + i, size - i);
+		if (length == 0)
+			return i;
+		i += length;
+	}
+
+	return size;
+}
+
+char32_t utf8::decode(const char* data, size_t length)
+{
+	auto bytes = reinterpret_cast<const unsigned char*>(data);
+
+	switch (length)
+	{
+	case 1:
+		return bytes[0];
+	case 2:
+		return	(char32_t(bytes[0] & 0x1F) << 6)	|  (bytes[1] & 0x3F);
+	case 3:
+		return	(char32_t(bytes[0] & 0x0F) << 12)	| (char32_t(bytes[1] & 0x3F) << 6)	| (bytes[2] & 0x3F);
+	case 4:
+		return	(char32_t(bytes[0] & 0x07) << 18)	| (char32_t(bytes[1] & 0x3F) << 12)	|
+				(char32_t(bytes[2] & 0x3F) << 6)	|  (bytes[3] & 0x3F);
+	}
+
+	return invalid;
+}
+
+bool utf8::is_identifier_start(char32_t code_point)
+{
+	return in_ranges(xid_start, code_point);
+}
+
+bool utf8::is_identifier_continue(char32_t code_point)
+{
+	return in_ranges(xid_continue, code_point);
+}
@@ -0,0 +1,153 @@
+#include "value.hpp"
+
+#include <charconv>
+#include <cmath>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "inline strings are read in place");
+
+Value Value::floating(double value)
+{
+	if (std::isnan(value))
+		return Value(0x7FF8'0000'0000'0000);
+
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return Value(bits);
+}
+
+Value Value::integer(int64_t value, std::pmr::memory_resource* resource)
+{
+	// 48 bits survive the round trip through the payload
+	if (int64_t(uint64_t(value) << 16) >> 16 == value)
+		return Value(box(tag_integer, uint64_t(value)));
+
+	auto boxed = static_cast<int64_t*>(resource->allocate(sizeof(int64_t), alignof(int64_t)));
+	*boxed = value;
+	return Value(box(tag_big_integer, uintptr_t(boxed)));
+}
+
+Value Value::string(std::string_view value, std::pmr::memory_resource* resource)
+{
+	if (value.size() <= max_inline_string)
+	{
+		// characters in the low bytes, the size in the byte above them
+		uint64_t payload = uint64_t(value.size()) << 40;
+		std::memcpy(&payload, value.data(), value.size());
+		return Value(box(tag_string, payload));
+	}
+
+	auto object = new_string(value.size(), resource);
+	std::memcpy(object->m_data, value.data(), value.size());
+
+	return Value(box(tag_big_string, uintptr_t(object)));
+}
+
+Value Value::concatenate(std::string_view left, std::string_view right, std::pmr::memory_resource* resource)
+{
+	auto size = left.size() + right.size();
+	if (size <= max_inline_string)
+	{
+		char joined[max_inline_string];
+		std::memcpy(joined, left.data(), left.size());
+		std::memcpy(joined + left.size(), right.data(), right.size());
+		return string(std::string_view(joined, size), resource);
+	}
+
+	auto object = new_string(size, resource);
+	std::memcpy(object->m_data, left.data(), left.size());
+	std::memcpy(object->m_data + left.size(), right.data(), right.size());
+
+	return Value(box(tag_big_string, uintptr_t(object)));
+}
+
+Value::StringObject* Value::new_string(size_t size, std::pmr::memory_resource* resource)
+{
+	auto object = static_cast<StringObject*>(
+		resource->allocate(offsetof(StringObject, m_data) + size, alignof(StringObject))
+	);
+	object->m_size = size;
+	return object;
+}
+
+Value::Type Value::type() const
+{
+	switch (tag())
+	{
+	case tag_nil:			return Type::nil;
+	case tag_boolean:		return Type::boolean;
+	case tag_integer:
+	case tag_big_integer:	return Type::integer;
+	case tag_string:
+	case tag_big_string:	return Type::string;
+	default:				return Type::floating;
+	}
+}
+
+std::string_view Value::as_string() const
+{
+	if (tag() == tag_string)
+		return std::string_view(reinterpret_cast<const char*>(&m_bits), size_t(m_bits >> 40) & 0xFF);
+
+	auto object = static_cast<const StringObject*>(pointer());
+	return std::string_view(object->m_data, object->m_size);
+}
+
+bool Value::truthy() const
+{
+	switch (type())
+	{
+	case Type::nil:		return false;
+	case Type::boolean:	return as_boolean();
+	case Type::integer:	return as_integer() != 0;
+	case Type::string:	return !as_string().empty();
+	default:			return as_floating() != 0;
+	}
+}
+
+Value Value::copy_to(std::pmr::memory_resource* resource) const
+{
+	switch (tag())
+	{
+	case tag_big_integer:	return integer(as_integer(), resource);
+	case tag_big_string:	return string(as_string(), resource);
+	default:				return *this;
+	}
+}
+
+size_t Value::heap_size() const
+{
+	switch (tag())
+	{
+	case tag_big_integer:	return sizeof(int64_t);
+	case tag_big_string:	return offsetof(StringObject, m_data) + as_string().size();
+	default:				return 0;
+	}
+}
+
+std::ostream& operator<<(std::ostream& out, const Value& value)
+{
+	switch (value.type())
+	{
+	case Value::Type::nil:
+		return out << "nil";
+	case Value::Type::boolean:
+		return out << (value.as_boolean() ? "true" : "false");
+	case Value::Type::integer:
+		return out << value.as_integer();
+	case Value::Type::string:
+		return out << value.as_string();
+	default:
+		break;
+	}
+
+	char buffer[32];
+	auto result = std::to_chars(buffer, buffer + sizeof(buffer), value.as_floating());
+	std::string_view text(buffer, size_t(result.ptr - buffer));
+
+	out << text;
+	// keep floatings recognisable, 2.0 isn't printed as the integer 2
+	if (std::isfinite(value.as_floating()) && text.find_first_of(".e") == std::string_view::npos)
+		out << ".0";
+
+	return out;
+}